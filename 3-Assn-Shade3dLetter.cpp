@@ -225,9 +225,9 @@ int main() {
 	RegisterResize(Resize);
 	
 	while (!glfwWindowShouldClose(w)) {
+		glfwPollEvents();	// before Display, so input shows in this frame
 		Display();
 		glfwSwapBuffers(w);
-		glfwPollEvents();
 	}
 	
 	// finish
@@ -16,6 +16,8 @@
 #include "IO.h"
 #include "Camera.h"
 #include <iostream>
+#include <algorithm>
+#include <float.h>
 
 // display
 int winWidth = 800, winHeight = 800;					// window size, in pixels
@@ -25,7 +27,7 @@ mat4 standardizeMat;									// scale/center letter
 Mover mover;		 // to move light
 void* picked = NULL;	// user selection (&mover or &camera)
 
-vec3 points[] = { {150, 230}, {50, 50}, {150, 75}, {220, 110}, {250, 150},
+vector<vec3> points = { {150, 230}, {50, 50}, {150, 75}, {220, 110}, {250, 150},
 {250, 270}, {230, 310}, {170, 350}, {50, 350}, {50, 230},
 
 {150, 230, -50}, {50, 50, -50}, {150, 75, -50}, {220, 110, -50}, {250, 150, -50},
@@ -34,8 +36,8 @@ vec3 points[] = { {150, 230}, {50, 50}, {150, 75}, {220, 110}, {250, 150},
 vec3 colors[] = { {0, 0, 1}, {1, 0, 0}, {0, 1, 0},
 	{0, 0, 1}, {1, 0, 0}, {0, 1, 0}, {0.5, 0.5, 0.5} };	// colors for vertices
 
-const int nPoints = sizeof(points) / sizeof(vec3);
-vec2 uvs[nPoints];
+int nPoints = points.size();
+vector<vec2> uvs;	// atlas location per vertex, set by Unwrap
 
 
 // texture image
@@ -48,7 +50,7 @@ vec3 lights[] = { {.5, 0, 1}, {1, 1, 0} };
 const int nLights = sizeof(lights) / sizeof(vec3);
 
 // vertex indices of triangles
-int triangles[][3] = { {0,1,2}, {0,2,3}, {0,3,4}, {0,4,5},
+vector<int3> triangles = { {0,1,2}, {0,2,3}, {0,3,4}, {0,4,5},
 {0,5,6}, {0,6,7}, {0,7,8}, {0,8,9}, {0, 9, 1},
 
 {10, 12, 11}, {10, 13, 12}, {10, 14, 13}, {10, 15, 14},
@@ -59,7 +61,7 @@ int triangles[][3] = { {0,1,2}, {0,2,3}, {0,3,4}, {0,4,5},
 	{7, 6, 16}, {17, 7, 16}, {8, 7, 17}, {18, 8, 17}, {9, 8, 18}, {19, 9, 18}
 };
 
-const int nTriangles = sizeof(triangles) / sizeof(triangles[0]);
+int nTriangles = triangles.size();
 
 // OpenGL IDs for vertex buffer and shader program
 GLuint vBuffer = 0, program = 0;
@@ -71,14 +73,6 @@ Camera camera(0, 0, winWidth, winHeight, vec3(15, -30, 0), vec3(0, 0, -5), 30);
 // bool variable to track whether highlights are on or not
 bool onHighlights = true;
 
-void SetUvs() {
-	vec3 min, max;
-	Bounds(points, nPoints, min, max);
-	vec3 dif(max - min);
-	for (int i = 0; i < nPoints; i++)
-		uvs[i] = vec2((points[i].x - min.x) / dif.x, (points[i].y - min.y) / dif.y);
-}
-
 // Vertex shader
 const char* vertexShader = R"(
 	#version 130
@@ -156,7 +150,6 @@ void Display() {
 	glUseProgram(program);
 
 	// set transform
-	mat4 view = RotateY(mouseNow.x) * RotateX(mouseNow.y) * standardizeMat;
 	SetUniform(program, "modelview", camera.modelview);
 	SetUniform(program, "persp", camera.persp);
 	SetUniform(program, "textureImage", textureUnit);
@@ -170,13 +163,12 @@ void Display() {
 	glBindTexture(GL_TEXTURE_2D, textureName);
 	glActiveTexture(GL_TEXTURE0 + textureUnit);
 	VertexAttribPointer(program, "point", 3, 0, (void*)0);
-	VertexAttribPointer(program, "uv", 2, 0, (void*)sizeof(points));
+	VertexAttribPointer(program, "uv", 2, 0, (void*)(nPoints * sizeof(vec3)));
 
 	// render
-	glDrawElements(GL_TRIANGLES, sizeof(triangles) / sizeof(int), GL_UNSIGNED_INT, triangles);
+	glDrawElements(GL_TRIANGLES, 3 * nTriangles, GL_UNSIGNED_INT, triangles.data());
 
-	// test connectivity
-	UseDrawShader(view);
+	// annotation shader uses camera transform
 	UseDrawShader(camera.fullview);
 	
 	// draw lights
@@ -226,7 +218,7 @@ void MouseWheel(float spin) {
 void StandardizePoints(float s = 1) {
 	// scale and offset so points in +/-s, centered at origin
 	vec3 min, max;
-	float range = Bounds(points, nPoints, min, max);
+	float range = Bounds(points.data(), nPoints, min, max);
 	float scale = 2 * s / range;
 	vec3 center = (min + max) / 2;
 	for (int i = 0; i < nPoints; i++)
@@ -235,7 +227,7 @@ void StandardizePoints(float s = 1) {
 
 mat4 StandardizeMatrix(float s = 1) {
 	vec3 min, max;
-	float f = 2 * s / Bounds(points, nPoints, min, max);
+	float f = 2 * s / Bounds(points.data(), nPoints, min, max);
 	return Scale(f) * Translate(-vec3((min + max) / 2));
 }
 
@@ -245,11 +237,222 @@ void BufferVertices(vec3* points, vec3* colors, int npoints) {
 	glBindBuffer(GL_ARRAY_BUFFER, vBuffer);
 	// allocate memory
 	int sPoints = npoints * sizeof(vec3), sColors = npoints * sizeof(vec3);
-	int sUvs = nPoints * sizeof(vec2);
+	int sUvs = npoints * sizeof(vec2);
 	glBufferData(GL_ARRAY_BUFFER, sPoints + sUvs, NULL, GL_STATIC_DRAW);
 	// copy to sub-buffers
 	glBufferSubData(GL_ARRAY_BUFFER, 0, sPoints, points);
-	glBufferSubData(GL_ARRAY_BUFFER, sPoints, sUvs, uvs);
+	glBufferSubData(GL_ARRAY_BUFFER, sPoints, sUvs, uvs.data());
+}
+
+// edge k (vertex k to k+1) of triangle t, as vertex pair a < b
+struct HalfEdge { int a, b, t, k; };
+
+vector<HalfEdge> SortedEdges() {
+	// half-edges of all triangles, sorted so the two sides of an edge are adjacent
+	vector<HalfEdge> edges;
+	for (int t = 0; t < nTriangles; t++)
+		for (int k = 0; k < 3; k++) {
+			int a = triangles[t][k], b = triangles[t][(k + 1) % 3];
+			edges.push_back(HalfEdge{ std::min(a, b), std::max(a, b), t, k });
+		}
+	std::sort(edges.begin(), edges.end(), [](const HalfEdge& e1, const HalfEdge& e2) {
+		return e1.a != e2.a ? e1.a < e2.a : e1.b < e2.b;
+	});
+	return edges;
+}
+
+// letter-only test case for the mesh check: reports edges not shared by exactly
+// two triangles, and triangle pairs that traverse a shared edge in the same
+// direction (inconsistent winding); Assignment-5 has the full, radix-sorted check
+void CheckMesh(const vector<HalfEdge>& edges) {
+	int nProblems = 0;
+	for (size_t i = 0, j; i < edges.size(); i = j) {
+		for (j = i + 1; j < edges.size() && edges[j].a == edges[i].a && edges[j].b == edges[i].b; j++)
+			;
+		int a = edges[i].a, b = edges[i].b;
+		if (j - i != 2) {
+			printf("edge %i-%i used by %i triangles\n", a, b, (int)(j - i));
+			nProblems++;
+		}
+		else {
+			// a precedes b in exactly one of the two triangles if consistently wound
+			int t1 = edges[i].t, t2 = edges[i + 1].t;
+			auto Forward = [a](const HalfEdge& e) { return triangles[e.t][e.k] == a; };
+			if (Forward(edges[i]) == Forward(edges[i + 1])) {
+				printf("triangles %i and %i wound inconsistently across edge %i-%i\n", t1, t2, a, b);
+				nProblems++;
+			}
+		}
+	}
+	printf("letter mesh: %i triangles, %i edge problems\n", nTriangles, nProblems);
+}
+
+// UV Atlas
+
+const float creaseAngle = 60;	// charts are cut along edges that bend more than this, in degrees
+
+vector<int3> EdgeNeighbors(const vector<HalfEdge>& edges) {
+	// triangle across edge k (from vertex k to k+1) of each triangle, -1 if boundary or non-manifold
+	vector<int3> neighbors(nTriangles, int3(-1, -1, -1));
+	for (size_t i = 0, j; i < edges.size(); i = j) {
+		for (j = i + 1; j < edges.size() && edges[j].a == edges[i].a && edges[j].b == edges[i].b; j++)
+			;
+		if (j - i == 2) {
+			neighbors[edges[i].t][edges[i].k] = edges[i + 1].t;
+			neighbors[edges[i + 1].t][edges[i + 1].k] = edges[i].t;
+		}
+	}
+	return neighbors;
+}
+
+vec2 Unfold(vec3 p, vec3 q, vec3 r, vec2 P, vec2 Q) {
+	// place r in the uv plane so triangle pqr keeps its edge lengths and is counter-clockwise
+	vec3 e = q - p;
+	float d = length(e), along = dot(r - p, e) / d, across = length(cross(r - p, e)) / d;
+	vec2 x = Q - P;
+	x = x / sqrt(x.x * x.x + x.y * x.y);
+	return P + along * x + across * vec2(-x.y, x.x);
+}
+
+void Unwrap(const vector<HalfEdge>& edges) {
+	// replace planar projection (which collapses the side walls) with a texture atlas:
+	// grow charts across edges with small dihedral angle, unfold each chart triangle by
+	// triangle (exact for the flat caps and the developable side walls), align each chart
+	// with its principal axis, then pack chart bounding boxes with a skyline packer
+	double start = glfwGetTime();
+	float cosCrease = cos(creaseAngle * 3.1415926f / 180);
+	vector<int3> neighbors = EdgeNeighbors(edges);
+	vector<vec3> faceNormals(nTriangles);
+	for (int t = 0; t < nTriangles; t++) {
+		vec3 n = cross(points[triangles[t][1]] - points[triangles[t][0]], points[triangles[t][2]] - points[triangles[t][0]]);
+		faceNormals[t] = length(n) > 0 ? n / length(n) : n;
+	}
+	// charts: vertices are copied per chart, so uvs may differ across chart boundaries
+	struct Chart { int first, end; vec2 size, offset; };
+	vector<Chart> charts;
+	vector<vec3> chartPoints;
+	vector<vec2> chartUvs;
+	vector<int3> chartTriangles(nTriangles);
+	vector<int> chartOf(nTriangles, -1), copyOf(nPoints, -1);
+	for (int seed = 0; seed < nTriangles; seed++) {
+		if (chartOf[seed] >= 0)
+			continue;
+		int first = chartPoints.size();
+		auto AddVertex = [&](int v, vec2 uv) {
+			// reuse this chart's copy of v if unfolded to the same place, else copy v
+			int i = copyOf[v];
+			if (i >= first && fabs(chartUvs[i].x - uv.x) + fabs(chartUvs[i].y - uv.y) < 1e-4f)
+				return i;
+			copyOf[v] = chartPoints.size();
+			chartPoints.push_back(points[v]);
+			chartUvs.push_back(uv);
+			return copyOf[v];
+		};
+		int3 s = triangles[seed];
+		vec2 P(0, 0), Q(length(points[s[1]] - points[s[0]]), 0);
+		vec2 R = Unfold(points[s[0]], points[s[1]], points[s[2]], P, Q);
+		chartTriangles[seed] = int3(AddVertex(s[0], P), AddVertex(s[1], Q), AddVertex(s[2], R));
+		chartOf[seed] = charts.size();
+		vector<int> queue(1, seed);
+		for (size_t i = 0; i < queue.size(); i++) {
+			int t = queue[i];
+			for (int k = 0; k < 3; k++) {
+				int n = neighbors[t][k];
+				if (n < 0 || chartOf[n] >= 0 || dot(faceNormals[t], faceNormals[n]) < cosCrease)
+					continue;
+				chartOf[n] = charts.size();
+				queue.push_back(n);
+				// edge a->b of t is b->a of n; unfold n's third vertex across it
+				int a = chartTriangles[t][k], b = chartTriangles[t][(k + 1) % 3], j = 0;
+				while (triangles[n][j] != triangles[t][(k + 1) % 3])
+					j++;
+				int r = triangles[n][(j + 2) % 3];
+				vec2 uv = Unfold(chartPoints[b], chartPoints[a], points[r], chartUvs[b], chartUvs[a]);
+				chartTriangles[n][j] = b;
+				chartTriangles[n][(j + 1) % 3] = a;
+				chartTriangles[n][(j + 2) % 3] = AddVertex(r, uv);
+			}
+		}
+		// rotate chart so its principal axis lies along u, then move it to the origin
+		int end = chartPoints.size();
+		vec2 mean(0, 0);
+		for (int i = first; i < end; i++)
+			mean += chartUvs[i] / (float)(end - first);
+		float cxx = 0, cxy = 0, cyy = 0;
+		for (int i = first; i < end; i++) {
+			vec2 d = chartUvs[i] - mean;
+			cxx += d.x * d.x, cxy += d.x * d.y, cyy += d.y * d.y;
+		}
+		float angle = .5f * atan2(2 * cxy, cxx - cyy), c = cos(angle), sn = sin(angle);
+		vec2 min(FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX);
+		for (int i = first; i < end; i++) {
+			vec2 d = chartUvs[i] - mean;
+			chartUvs[i] = vec2(c * d.x + sn * d.y, -sn * d.x + c * d.y);
+			min = vec2(std::min(min.x, chartUvs[i].x), std::min(min.y, chartUvs[i].y));
+			max = vec2(std::max(max.x, chartUvs[i].x), std::max(max.y, chartUvs[i].y));
+		}
+		for (int i = first; i < end; i++)
+			chartUvs[i] = chartUvs[i] - min;
+		charts.push_back(Chart{ first, end, max - min, vec2(0, 0) });
+	}
+	// skyline packing: tallest charts first, each at the lowest spot along the skyline
+	float area = 0, maxWidth = 0;
+	for (Chart& c : charts)
+		area += c.size.x * c.size.y, maxWidth = std::max(maxWidth, c.size.x);
+	float pad = .02f * sqrt(area);	// gutter so mipmaps don't bleed between charts
+	float width = std::max(maxWidth + pad, sqrt(area) * 1.2f), height = 0;
+	vector<int> order(charts.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int i, int j) { return charts[i].size.y > charts[j].size.y; });
+	struct Segment { float x, y, w; };
+	vector<Segment> skyline(1, Segment{ 0, 0, width });
+	for (int i : order) {
+		float w = charts[i].size.x + pad, h = charts[i].size.y + pad, bestX = 0, bestY = FLT_MAX;
+		for (size_t s = 0; s < skyline.size() && skyline[s].x + w <= width; s++) {
+			float x = skyline[s].x, y = 0;
+			for (size_t k = s; k < skyline.size() && skyline[k].x < x + w; k++)
+				y = std::max(y, skyline[k].y);
+			if (y < bestY)
+				bestX = x, bestY = y;
+		}
+		charts[i].offset = vec2(bestX + pad / 2, bestY + pad / 2);
+		height = std::max(height, bestY + h);
+		// raise skyline over [bestX, bestX+w)
+		vector<Segment> raised;
+		bool placed = false;
+		for (Segment s : skyline) {
+			float sEnd = s.x + s.w, right = bestX + w;
+			if (sEnd <= bestX || s.x >= right) {
+				raised.push_back(s);
+				continue;
+			}
+			if (s.x < bestX)
+				raised.push_back(Segment{ s.x, s.y, bestX - s.x });
+			if (!placed)
+				raised.push_back(Segment{ bestX, bestY + h, w });
+			placed = true;
+			if (sEnd > right)
+				raised.push_back(Segment{ right, s.y, sEnd - right });
+		}
+		skyline = raised;
+	}
+	// scale atlas to unit square
+	float scale = 1 / std::max(width, height), used = 0;
+	for (Chart& c : charts)
+		for (int i = c.first; i < c.end; i++)
+			chartUvs[i] = scale * (chartUvs[i] + c.offset);
+	for (int3 t : chartTriangles) {
+		vec2 e1 = chartUvs[t[1]] - chartUvs[t[0]], e2 = chartUvs[t[2]] - chartUvs[t[0]];
+		used += .5f * fabs(e1.x * e2.y - e1.y * e2.x);
+	}
+	points = chartPoints;
+	uvs = chartUvs;
+	triangles = chartTriangles;
+	nPoints = points.size();
+	double dt = glfwGetTime() - start;
+	printf("atlas: %i charts, %i vertices, %2.0f%% texel utilization, unwrapped in %3.4f secs (%3.2f secs/M triangles)\n",
+		(int)charts.size(), nPoints, 100 * used, dt, 1e6 * dt / nTriangles);
 }
 
 // resize callback
@@ -303,14 +506,23 @@ int main() {
 	program = LinkProgramViaCode(&vertexShader, &pixelShader);
 	const char* textureFilename = "C:/Users/duong/Graphics/Apps/picture.jpg";
 	// fit letter to window
-	Standardize(points, nPoints, .8f);
+	Standardize(points.data(), nPoints, .8f);
 	standardizeMat = StandardizeMatrix(.8f);	// option: use matrix to normalize and center
 
 	textureName = ReadTexture(textureFilename);
-	SetUvs();
+	if (textureName) {
+		// mipmaps and trilinear filtering
+		glBindTexture(GL_TEXTURE_2D, textureName);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	vector<HalfEdge> edges = SortedEdges();	// for both, as Unwrap replaces triangles
+	CheckMesh(edges);
+	Unwrap(edges);
 
 	// copy vertices to GPU memory
-	BufferVertices(points, colors, nPoints);
+	BufferVertices(points.data(), colors, nPoints);
 	// register keyboard callback
 	glfwSetKeyCallback(w, KeyCallback);
 	// callbacks and event loop
@@ -321,9 +533,9 @@ int main() {
 	RegisterResize(Resize);
 
 	while (!glfwWindowShouldClose(w)) {
+		glfwPollEvents();	// before Display, so input shows in this frame
 		Display();
 		glfwSwapBuffers(w);
-		glfwPollEvents();
 	}
 
 	// Writing to file
@@ -77,9 +77,9 @@ int main() {		// application entry
 	InitVertexBuffer();												// allocate GPU vertex buffer
 	RegisterKeyboard(Keyboard);										// callback for user key press
 	while (!glfwWindowShouldClose(w)) {								// event loop
+		glfwPollEvents();											// input applies to this frame
 		Display();
 		glfwSwapBuffers(w);											// double-buffer is default
-		glfwPollEvents();
 	}
 	glfwDestroyWindow(w);
 	glfwTerminate();
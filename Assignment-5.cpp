@@ -14,6 +14,14 @@
 #include "VecMat.h"
 #include "Widgets.h"
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <float.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
 
 // display
 int winWidth = 800, winHeight = 800;
@@ -24,26 +32,51 @@ vector<vec3> points; // vertex locations
 vector<vec3> normals; // surface normals
 vector<vec2> uvs; // texture coordinates
 vector<int3> triangles; // triplets of vertex indices
+vector<float> ao; // per-vertex ambient occlusion (1: fully open), baked after read
+vector<vec4> tangents; // per-vertex tangent (xyz) and bitangent sign (w), for normal mapping
 
-const int nPoints = sizeof(points)/sizeof(vec3);
+// mesh is parsed on a loader thread, buffered by the render thread once complete
+string sourceFilename = "Doughnut_OBJ.obj";	// ASCII OBJ or binary PLY, optionally given on command line
+string meshFilename = "Doughnut_OBJ.msh";	// compressed copy, read in preference to source if newer
+int torusRings = 0;							// if > 0, generate torus instead of reading source
+std::thread loader;
+std::atomic<int> meshStatus(0); // 0: loading, 1: read, -1: failed
+bool meshBuffered = false;      // set after BufferVertices, mesh drawn only when true
+double loadStart = 0;
 
-// OpenGL IDs for vertex buffer, shader program
-GLuint vBuffer = 0, program = 0;
+// OpenGL IDs for vertex buffer, triangle index buffer, shader program
+GLuint vBuffer = 0, eBuffer = 0, program = 0;
+
+// layout of buffered mesh, so Display needn't read mesh arrays while a reload replaces them
+size_t uvOffset = 0, normalOffset = 0, aoOffset = 0, tangentOffset = 0;
+int nBufferedIndices = 0;
 
 // texture image
 const char *textFilename = "C:/Users/duong/Graphics/Apps/donutTextureImage.jpg";
 GLuint textureName = 0;
 int textureUnit = 0;
 
+// optional tangent-space normal map
+const char *normalMapFilename = "C:/Users/duong/Graphics/Apps/donutNormalMap.jpg";
+GLuint normalMapName = 0;
+int normalMapUnit = 1;
+
 // movable lights       
 vec3 lights[] = { {.5, 0, 1}, {1, 1, 0} };
 const int nLights = sizeof(lights)/sizeof(vec3);
 
 // interaction
 void *picked = NULL;	// if non-null: light or camera
+int pickedLight = -1;	// index of light being dragged
 Mover mover;
 
+// input latency: from callback of first input since last frame to return of swap that shows it
+double inputTime = 0;		// 0 if no input pending
+vector<float> latencies;	// in msecs
+bool lateLatch = false;		// if true, re-read cursor and update camera just before the draw
+
 bool useFacetedNormal = true;
+bool useAo = true;
 float ambientValue = 0.1f;
 float diffuseValue = 0.5f;
 float specularValue = 0.8f;
@@ -53,26 +86,42 @@ float shininessValue = 32.0f;
 
 const char *vertexShader = R"(
 	#version 130
-	in vec3 vPoint;
+	in vec3 point;
 	in vec2 uv;
 	in vec3 normal;
+	in float ao;
+	in vec4 tangent;
+	out vec3 vPoint;
+	out float vAo;
+	out vec4 vTangent;
 	out vec2 vUv;
 	out vec3 vNormal;
 	uniform mat4 modelview, persp;
 	void main() {
-		gl_Position = persp * modelview * vec4(vPoint, 1);
+		vPoint = (modelview * vec4(point, 1)).xyz;
+		gl_Position = persp * vec4(vPoint, 1);
 		vUv = uv;
+		vAo = ao;
 		vNormal = normalize((modelview * vec4(normal, 0)).xyz);
+		vTangent = vec4((modelview * vec4(tangent.xyz, 0)).xyz, tangent.w);
 	}
 )";
 
 const char* pixelShader = R"(
 	#version 130
+	in vec3 vPoint;
 	in vec2 vUv; // Receive texture coordinates from vertex shader
 	in vec3 vNormal;
+	in float vAo;
+	in vec4 vTangent;
 	out vec4 pColor;
+	uniform int nLights = 0;
+	uniform vec3 lights[20];
 	uniform sampler2D textureImage;
+	uniform sampler2D normalMap;
+	uniform bool useNormalMap = false;
 	uniform bool useFacetedNormal;
+	uniform bool useAo = true;
 	uniform float ambientValue;
     uniform float diffuseValue;
     uniform float specularValue;
@@ -83,59 +132,306 @@ const char* pixelShader = R"(
 		if (useFacetedNormal) {
 			N = normalize(vNormal); // Use normal from the vertex shader (faceted shading)
 		} else {
-			N = normalize(cross(dFdx(vPosition), dFdy(vPosition))); // Use normal from the rasterizer (smooth shading)
+			N = normalize(cross(dFdx(vPoint), dFdy(vPoint))); // Use normal from the rasterizer (smooth shading)
+		}
+		if (useNormalMap) {
+			// perturb N by normal map in tangent space (T, B, N)
+			vec3 T = normalize(vTangent.xyz - dot(vTangent.xyz, N) * N);
+			vec3 B = vTangent.w * cross(N, T);
+			vec3 m = 2 * texture(normalMap, vUv).rgb - 1;
+			N = normalize(m.x * T + m.y * B + m.z * N);
 		}
 		vec4 textColor = texture(textureImage, vUv); // Sample the texture using texture coordinates
-		pColor = textColor; // Set the fragment color to the sampled texture color
+		vec3 E = normalize(-vPoint);
+		float intensity = ambientValue;
+		for (int i = 0; i < nLights; i++) {
+			vec3 L = normalize(lights[i] - vPoint);
+			vec3 R = reflect(-L, N);
+			intensity += diffuseValue * max(dot(N, L), 0) + specularValue * pow(max(dot(R, E), 0), shininessValue);
+		}
+		pColor = vec4(intensity * textColor.rgb, textColor.a); // Set the fragment color to the lit texture color
+		if (useAo)
+			pColor.rgb *= vAo; // darken by baked occlusion
 	}
 
 )";
 
+// Overlay
+
+// annotation accumulated over a frame and drawn with one streamed buffer, one draw for lines
+// and one for points; vertices are stored in clip space, so the GPU clips them, and markers
+// are offset by pixels scaled by w so they keep their size on screen
+vector<vec4> overlayLines, overlayPoints;
+vector<vec3> overlayLineColors, overlayPointColors;
+GLuint overlayBuffer = 0, overlayArray = 0, overlayProgram = 0;
+int overlayMarkers = 0, overlayDraws = 0, overlayFrames = 0;
+
+const char *overlayVertexShader = R"(
+	#version 130
+	in vec4 point;
+	in vec3 color;
+	out vec3 vColor;
+	void main() {
+		gl_Position = point;
+		vColor = color;
+	}
+)";
+
+const char *overlayPixelShader = R"(
+	#version 130
+	in vec3 vColor;
+	out vec4 pColor;
+	void main() {
+		pColor = vec4(vColor, 1);
+	}
+)";
+
+vec4 PixelOffset(vec4 c, vec2 pixels) {
+	return vec4(c.x+2*pixels.x/winWidth*c.w, c.y+2*pixels.y/winHeight*c.w, c.z, c.w);
+}
+
+void PixelLine(vec4 c, vec2 p1, vec2 p2, vec3 color1, vec3 color2) {
+	// line between two pixel offsets from clip-space point c
+	overlayLines.push_back(PixelOffset(c, p1));
+	overlayLines.push_back(PixelOffset(c, p2));
+	overlayLineColors.push_back(color1);
+	overlayLineColors.push_back(color2);
+}
+
+void OverlayLine(vec3 p1, vec3 p2, vec3 color1, vec3 color2) {
+	// endpoints behind the eye are fine: the GPU clips before the divide
+	overlayLines.push_back(camera.fullview*vec4(p1, 1));
+	overlayLines.push_back(camera.fullview*vec4(p2, 1));
+	overlayLineColors.push_back(color1);
+	overlayLineColors.push_back(color2);
+	overlayMarkers++;
+}
+
+void OverlayPoint(vec3 p, vec3 color) {
+	overlayPoints.push_back(camera.fullview*vec4(p, 1));
+	overlayPointColors.push_back(color);
+	overlayMarkers++;
+}
+
+void OverlayStar(vec3 p, float pixels, vec3 colorIn, vec3 colorOut) {
+	// eight spokes, pixels long, shaded from colorIn at p to colorOut at tips
+	vec4 c = camera.fullview*vec4(p, 1);
+	if (c.w <= 0)	// at or behind the eye: no screen position
+		return;
+	for (int i = 0; i < 8; i++) {
+		float a = i*3.1415926f/4;
+		PixelLine(c, vec2(0, 0), vec2(pixels*cos(a), pixels*sin(a)), colorIn, colorOut);
+	}
+	overlayMarkers++;
+}
+
+void OverlayText(vec3 p, vec2 offset, const char *text, float pixels, vec3 color) {
+	// digits and '-' as seven-segment strokes, pixels high, lower left at offset from p;
+	// strokes rather than textured quads, so text needs no font texture and shares the line draw
+	static const int segments[] = {0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x6f};
+	static const vec2 ends[7][2] = {	// segments a-g in a .5 by 1 cell
+		{{0, 1}, {.5f, 1}}, {{.5f, 1}, {.5f, .5f}}, {{.5f, .5f}, {.5f, 0}}, {{0, 0}, {.5f, 0}},
+		{{0, .5f}, {0, 0}}, {{0, 1}, {0, .5f}}, {{0, .5f}, {.5f, .5f}}};
+	vec4 c = camera.fullview*vec4(p, 1);
+	if (c.w <= 0)
+		return;
+	for (const char *s = text; *s; s++, offset.x += .8f*pixels) {
+		int bits = *s == '-'? 0x40 : *s >= '0' && *s <= '9'? segments[*s-'0'] : 0;
+		for (int k = 0; k < 7; k++)
+			if (bits & (1 << k))
+				PixelLine(c, offset+ends[k][0]*pixels, offset+ends[k][1]*pixels, color, color);
+	}
+	overlayMarkers++;
+}
+
+void FlushOverlay() {
+	// one buffer orphaned and refilled per frame, one draw for lines and one for points
+	int nLines = overlayLines.size(), nPoints = overlayPoints.size(), n = nLines+nPoints;
+	overlayFrames++;
+	if (n == 0)
+		return;
+	if (!overlayProgram)
+		overlayProgram = LinkProgramViaCode(&overlayVertexShader, &overlayPixelShader);
+	if (!overlayBuffer) {
+		glGenBuffers(1, &overlayBuffer);
+		glGenVertexArrays(1, &overlayArray);
+	}
+	glUseProgram(overlayProgram);
+	glBindVertexArray(overlayArray);
+	glBindBuffer(GL_ARRAY_BUFFER, overlayBuffer);
+	glBufferData(GL_ARRAY_BUFFER, n*(sizeof(vec4)+sizeof(vec3)), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, nLines*sizeof(vec4), overlayLines.data());
+	glBufferSubData(GL_ARRAY_BUFFER, nLines*sizeof(vec4), nPoints*sizeof(vec4), overlayPoints.data());
+	glBufferSubData(GL_ARRAY_BUFFER, n*sizeof(vec4), nLines*sizeof(vec3), overlayLineColors.data());
+	glBufferSubData(GL_ARRAY_BUFFER, n*sizeof(vec4)+nLines*sizeof(vec3), nPoints*sizeof(vec3), overlayPointColors.data());
+	VertexAttribPointer(overlayProgram, "point", 4, 0, (void *) 0);
+	VertexAttribPointer(overlayProgram, "color", 3, 0, (void *) (n*sizeof(vec4)));
+	if (nLines) {
+		glDrawArrays(GL_LINES, 0, nLines);
+		overlayDraws++;
+	}
+	if (nPoints) {
+		glPointSize(6);
+		glDrawArrays(GL_POINTS, nLines, nPoints);
+		overlayDraws++;
+	}
+	glBindVertexArray(0);
+	overlayLines.resize(0), overlayLineColors.resize(0), overlayPoints.resize(0), overlayPointColors.resize(0);
+}
+
+void PrintOverlay() {
+	if (overlayFrames)
+		printf("overlay: %3.1f markers in %3.1f draws per frame (previously one draw per marker)\n",
+			(float) overlayMarkers/overlayFrames, (float) overlayDraws/overlayFrames);
+}
+
 // Display
 
+// GL state last sent, so Display re-sends only what changed: the attribute layout is
+// recorded once in a vertex array object, uniforms and texture bindings are compared
+// with their previous values (program included, so a relinked program gets everything)
+GLuint vArray = 0;
+bool layoutChanged = true;	// set when buffers re-allocated or program relinked
+struct ViewState { GLuint program; mat4 modelview, persp; vec3 lights[nLights]; } sentView;
+struct TextureState { GLuint program, textureName, normalMapName; int useNormalMap, useAo; } sentTextures;
+int stateSent = 0, stateElided = 0;	// GL state calls issued and skipped
+
+template<class T> bool StateChanged(T &sent, const T &now, int nCalls) {
+	// true if now differs from sent (which is then updated); count calls needed or elided
+	bool changed = memcmp(&sent, &now, sizeof(T)) != 0;
+	if (changed)
+		sent = now;
+	(changed? stateSent : stateElided) += nCalls;
+	return changed;
+}
+
+void SetVertexLayout() {
+	// attribute pointers and index buffer, kept in vArray
+	if (!vArray)
+		glGenVertexArrays(1, &vArray);
+	glBindVertexArray(vArray);
+	glBindBuffer(GL_ARRAY_BUFFER, vBuffer);
+	VertexAttribPointer(program, "point", 3, 0, (void *) 0);
+	VertexAttribPointer(program, "uv", 2, 0, (void *) uvOffset);
+	VertexAttribPointer(program, "normal", 3, 0, (void *) normalOffset);
+	VertexAttribPointer(program, "ao", 1, 0, (void *) aoOffset);
+	VertexAttribPointer(program, "tangent", 4, 0, (void *) tangentOffset);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eBuffer);
+	layoutChanged = false;
+}
+
+void PrintStateChanges() {
+	int total = stateSent+stateElided;
+	printf("GL state calls: %i sent, %i elided (%2.0f%%)\n", stateSent, stateElided, total? 100.*stateElided/total : 0.);
+}
+
 void Display(GLFWwindow *w) {
 	// clear screen, enable blend, z-buffer
 	glClearColor(1, 1, 1, 1);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glEnable(GL_DEPTH_TEST);
-	// init shader program, connect GPU buffer to vertex shader
-	glUseProgram(program);
-	glBindBuffer(GL_ARRAY_BUFFER, vBuffer);
-	VertexAttribPointer(program, "point", 3, 0, (void *) 0);
-	VertexAttribPointer(program, "uv", 2, 0, (void *) sizeof(points));
-	VertexAttribPointer(program, "normal", 3, 0, (void*)(sizeof(points) + sizeof(uvs))); // Add normals
-	// update matrices
-	SetUniform(program, "modelview", camera.modelview);
-	SetUniform(program, "persp", camera.persp);
-	// update/transform lights
-	SetUniform(program, "nLights", nLights);
-	SetUniform3v(program, "lights", nLights, (float *) lights, camera.modelview);
-	// bind textureName to textureUnit
-	glBindTexture(GL_TEXTURE_2D, textureName);
-	glActiveTexture(GL_TEXTURE0+textureUnit);
-	SetUniform(program, "textureImage", textureUnit);
-	// render
-	int nVertices = triangles.size() * 3;
-	glDrawElements(GL_TRIANGLES, nVertices, GL_UNSIGNED_INT, triangles.data());
+	if (meshBuffered) {
+		// init shader program, connect GPU buffers to vertex shader
+		glUseProgram(program);
+		bool relayout = layoutChanged;	// SetVertexLayout clears it
+		if (relayout)
+			SetVertexLayout();
+		else
+			glBindVertexArray(vArray);
+		(relayout? stateSent : stateElided) += 7;
+		// update matrices, update/transform lights
+		ViewState view = { program, camera.modelview, camera.persp };
+		std::copy(lights, lights+nLights, view.lights);
+		if (StateChanged(sentView, view, 4)) {
+			SetUniform(program, "modelview", camera.modelview);
+			SetUniform(program, "persp", camera.persp);
+			SetUniform(program, "nLights", nLights);
+			SetUniform3v(program, "lights", nLights, (float *) lights, camera.modelview);
+		}
+		// bind textureName to textureUnit, normalMapName to normalMapUnit
+		TextureState textures = { program, textureName, normalMapName, normalMapName != 0 && tangentOffset != 0, useAo };
+		if (StateChanged(sentTextures, textures, 8)) {
+			glActiveTexture(GL_TEXTURE0+normalMapUnit);
+			glBindTexture(GL_TEXTURE_2D, normalMapName);
+			glActiveTexture(GL_TEXTURE0+textureUnit);
+			glBindTexture(GL_TEXTURE_2D, textureName);
+			SetUniform(program, "textureImage", textureUnit);
+			SetUniform(program, "normalMap", normalMapUnit);
+			SetUniform(program, "useNormalMap", textures.useNormalMap);
+			SetUniform(program, "useAo", useAo);
+		}
+		// late latch: re-apply camera drag from the cursor as it is now, not as last polled
+		if (lateLatch && picked == &camera && glfwGetMouseButton(w, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+			double x, y;
+			int width, height;
+			glfwGetCursorPos(w, &x, &y);
+			glfwGetWindowSize(w, &width, &height);
+			camera.Drag((float) x, (float) (height-y));	// callbacks receive y up from bottom
+			SetUniform(program, "modelview", camera.modelview);
+			SetUniform3v(program, "lights", nLights, (float *) lights, camera.modelview);
+			sentView.modelview = camera.modelview;
+		}
+		// render
+		glDrawElements(GL_TRIANGLES, nBufferedIndices, GL_UNSIGNED_INT, (void *) 0);
+		glBindVertexArray(0); // annotation draws from client memory
+	}
 	// annotation
 	glDisable(GL_DEPTH_TEST);
-	UseDrawShader(camera.fullview);
-	for (int i = 0; i < nLights; i++)
-		Star(lights[i], 8, vec3(1, .8f, 0), vec3(0, 0, 1));
-	if (picked == &camera && !Shift())
+	for (int i = 0; i < nLights; i++) {
+		OverlayStar(lights[i], 8, vec3(1, .8f, 0), vec3(0, 0, 1));
+		OverlayText(lights[i], vec2(8, 4), std::to_string(i).c_str(), 10, vec3(1, .8f, 0));
+	}
+	if (picked == &mover && pickedLight >= 0) {
+		// dragged light to the mesh center (standardized to the origin)
+		OverlayLine(lights[pickedLight], vec3(0, 0, 0), vec3(1, .8f, 0), vec3(0, 0, 1));
+		OverlayPoint(vec3(0, 0, 0), vec3(0, 0, 1));
+	}
+	FlushOverlay();
+	if (picked == &camera && !Shift()) {
+		// the arcball draws itself from its own (library) state, so it stays a separate draw
+		UseDrawShader(camera.fullview);
 		camera.arcball.Draw(Control());
+	}
 	glFlush();
 }
 
 // Mouse Callbacks
 
+// times are passed in (glfwGetTime() from callbacks and event loop), so input and swap can be simulated
+
+void InputEvent(double now) {
+	if (inputTime == 0)
+		inputTime = now;
+}
+
+void FrameShown(double now) {
+	if (inputTime > 0)
+		latencies.push_back((float) (1000*(now-inputTime)));
+	inputTime = 0;
+}
+
+void PrintLatency() {
+	if (latencies.empty())
+		return;
+	vector<float> l(latencies);
+	std::sort(l.begin(), l.end());
+	auto Percentile = [&l](double p) {	// nearest rank
+		return l[std::max(0, (int) ceil(p*l.size())-1)];
+	};
+	printf("input latency (msecs, %i frames): 50%% %3.1f, 90%% %3.1f, 99%% %3.1f, max %3.1f\n",
+		(int) l.size(), Percentile(.5), Percentile(.9), Percentile(.99), l.back());
+}
+
 void MouseButton(float x, float y, bool left, bool down) {
+	InputEvent(glfwGetTime());
 	picked = NULL;
+	pickedLight = -1;
 	if (left && down) {
 		// light picked?
 		for (int i = 0; i < nLights; i++)
 			if (MouseOver(x, y, lights[i], camera.fullview)) {
 				picked = &mover;
+				pickedLight = i;
 				mover.Down(&lights[i], (int) x, (int) y, camera.modelview, camera.persp);
 			}
 		if (picked == NULL) {
@@ -147,6 +443,8 @@ void MouseButton(float x, float y, bool left, bool down) {
 }
 
 void MouseMove(float x, float y, bool leftDown, bool rightDown) {
+	if (leftDown)
+		InputEvent(glfwGetTime());
 	if (leftDown) {
 		if (picked == &mover)
 			mover.Drag((int) x, (int) y, camera.modelview, camera.persp);
@@ -156,37 +454,1499 @@ void MouseMove(float x, float y, bool leftDown, bool rightDown) {
 }
 
 void MouseWheel(float spin) {
+	InputEvent(glfwGetTime());
 	camera.Wheel(spin, Shift());
 }
 
+// Parallel Point Operations
+
+const int minItemsPerThread = 1 << 16;	// smaller arrays are processed on the calling thread
+
+int NThreads(int n, int minPerThread = minItemsPerThread) {
+	return std::max(1, std::min((int) std::thread::hardware_concurrency(), n/minPerThread));
+}
+
+template<class F> void ParallelFor(int n, int nThreads, F f) {
+	// call f(thread, begin, end) on nThreads contiguous sub-ranges of [0, n)
+	if (nThreads == 1) {
+		f(0, 0, n);
+		return;
+	}
+	vector<std::thread> threads;
+	int chunk = (n+nThreads-1)/nThreads;
+	for (int t = 0; t < nThreads; t++)
+		threads.push_back(std::thread(f, t, std::min(n, t*chunk), std::min(n, (t+1)*chunk)));
+	for (std::thread &t : threads)
+		t.join();
+}
+
+void StandardizePoints(vector<vec3> &pts, float s = 1) {
+	// scale and offset so points in +/-s, centered at origin
+	// loops run over flat floats with no branches so the compiler can vectorize them
+	int n = pts.size(), nThreads = NThreads(n);
+	float *f = (float *) pts.data();
+	vector<vec3> mins(nThreads, vec3(FLT_MAX, FLT_MAX, FLT_MAX)), maxs(nThreads, vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+	ParallelFor(n, nThreads, [&](int t, int begin, int end) {
+		// bounds per lane over blocks of 8 points (24 floats, whole SIMD registers),
+		// lane j holding component j%3; then lanes and leftover points are folded
+		const int nLanes = 24;
+		float lo[nLanes], hi[nLanes];
+		for (int j = 0; j < nLanes; j++)
+			lo[j] = FLT_MAX, hi[j] = -FLT_MAX;
+		int i = 3*begin, last = 3*end;
+		for (; i+nLanes <= last; i += nLanes)
+			for (int j = 0; j < nLanes; j++) {
+				float v = f[i+j];
+				lo[j] = v < lo[j]? v : lo[j];
+				hi[j] = v > hi[j]? v : hi[j];
+			}
+		for (int j = 0; i+j < last; j++) {
+			float v = f[i+j];
+			lo[j] = v < lo[j]? v : lo[j];
+			hi[j] = v > hi[j]? v : hi[j];
+		}
+		for (int j = 3; j < nLanes; j++) {
+			lo[j%3] = std::min(lo[j%3], lo[j]);
+			hi[j%3] = std::max(hi[j%3], hi[j]);
+		}
+		mins[t] = vec3(lo[0], lo[1], lo[2]);
+		maxs[t] = vec3(hi[0], hi[1], hi[2]);
+	});
+	vec3 min = mins[0], max = maxs[0];
+	for (int t = 1; t < nThreads; t++)
+		for (int k = 0; k < 3; k++) {
+			min[k] = std::min(min[k], mins[t][k]);
+			max[k] = std::max(max[k], maxs[t][k]);
+		}
+	vec3 dif = max-min;
+	float range = std::max(dif.x, std::max(dif.y, dif.z));
+	if (n == 0 || range <= 0)
+		return;
+	// p' = scale*(p-center) folded into one multiply-add per float
+	float scale = 2*s/range;
+	vec3 offset = scale*(min+max)/2;
+	ParallelFor(n, nThreads, [&](int t, int begin, int end) {
+		for (int i = begin; i < end; i++)
+			for (int k = 0; k < 3; k++)
+				f[3*i+k] = scale*f[3*i+k]-offset[k];
+	});
+}
+
+bool compareStandardize = false;	// set by -compare
+
+void CompareStandardize(vector<vec3> &pts, float s = 1) {
+	// standardize pts, timed against library Standardize on a copy, and report largest difference
+	vector<vec3> copy(pts);
+	double start = glfwGetTime();
+	Standardize(copy.data(), copy.size(), s);
+	double libraryTime = glfwGetTime()-start;
+	start = glfwGetTime();
+	StandardizePoints(pts, s);
+	double time = glfwGetTime()-start;
+	float maxError = 0;
+	for (size_t i = 0; i < pts.size(); i++)
+		for (int k = 0; k < 3; k++)
+			maxError = std::max(maxError, fabsf(pts[i][k]-copy[i][k]));
+	printf("standardize %i points: %3.2f ms (library %3.2f ms), max difference %g (%s)\n", (int) pts.size(),
+		1000*time, 1000*libraryTime, maxError, maxError <= 1e-5f*s? "ok" : "FAIL");
+}
+
+// Memory Accounting
+
+// bytes held per subsystem, set by the code that allocates or frees them, with peaks
+enum MemoryTag { MeshMemory, AoMemory, SubdivisionMemory, ReloadMemory, BufferMemory, TextureMemory, nMemoryTags };
+const char *memoryTagNames[] = { "mesh", "ao", "subdivision", "reload", "gpu buffers", "textures" };
+long long memoryBytes[nMemoryTags] = {}, memoryPeaks[nMemoryTags] = {}, memoryPeak = 0;
+std::mutex memoryLock;	// loader and render threads both report
+
+template<class T> long long Bytes(const vector<T> &v) { return (long long) v.capacity()*sizeof(T); }
+
+void TrackMemory(MemoryTag tag, long long bytes) {
+	std::lock_guard<std::mutex> lock(memoryLock);
+	memoryBytes[tag] = bytes;
+	memoryPeaks[tag] = std::max(memoryPeaks[tag], bytes);
+	long long total = 0;
+	for (int i = 0; i < nMemoryTags; i++)
+		total += memoryBytes[i];
+	memoryPeak = std::max(memoryPeak, total);
+}
+
+void PrintMemory() {
+	std::lock_guard<std::mutex> lock(memoryLock);
+	long long total = 0;
+	printf("memory (MB)      current    peak\n");
+	for (int i = 0; i < nMemoryTags; i++) {
+		printf("  %-12s %10.2f %7.2f\n", memoryTagNames[i], memoryBytes[i]/1e6, memoryPeaks[i]/1e6);
+		total += memoryBytes[i];
+	}
+	printf("  %-12s %10.2f %7.2f\n", "total", total/1e6, memoryPeak/1e6);
+}
+
+bool WriteMemoryJson(const char *filename) {
+	FILE *out = fopen(filename, "w");
+	if (!out)
+		return false;
+	std::lock_guard<std::mutex> lock(memoryLock);
+	long long total = 0;
+	fprintf(out, "{\n");
+	for (int i = 0; i < nMemoryTags; i++) {
+		fprintf(out, "  \"%s\": {\"current\": %lld, \"peak\": %lld},\n", memoryTagNames[i], memoryBytes[i], memoryPeaks[i]);
+		total += memoryBytes[i];
+	}
+	fprintf(out, "  \"total\": {\"current\": %lld, \"peak\": %lld}\n}\n", total, memoryPeak);
+	fclose(out);
+	return true;
+}
+
+// Ambient Occlusion
+
+struct BvhNode {
+	vec3 min, max;			// bounds of node's triangles
+	int first = 0, count = 0;	// leaf: range in bvhTriangles; interior: first is right child, count 0
+};
+
+vector<BvhNode> bvh;		// bvh[0] is root, left child immediately follows its parent
+vector<int> bvhTriangles;	// triangle indices, ordered by leaf
+
+void BoundTriangles(BvhNode &node) {
+	node.min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	node.max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int i = node.first; i < node.first+node.count; i++)
+		for (int v = 0; v < 3; v++) {
+			vec3 p = points[triangles[bvhTriangles[i]][v]];
+			for (int k = 0; k < 3; k++) {
+				node.min[k] = std::min(node.min[k], p[k]);
+				node.max[k] = std::max(node.max[k], p[k]);
+			}
+		}
+}
+
+void BuildBvh(int first, int count) {
+	// median split along longest axis of node bounds, 4 triangles per leaf
+	int n = bvh.size();
+	bvh.push_back(BvhNode());
+	bvh[n].first = first;
+	bvh[n].count = count;
+	BoundTriangles(bvh[n]);
+	if (count <= 4)
+		return;
+	vec3 dif = bvh[n].max-bvh[n].min;
+	int axis = dif.x > dif.y && dif.x > dif.z? 0 : dif.y > dif.z? 1 : 2;
+	auto centroid = [axis](int t) {
+		int3 tri = triangles[t];
+		return points[tri[0]][axis]+points[tri[1]][axis]+points[tri[2]][axis];
+	};
+	int half = count/2;
+	int *tris = bvhTriangles.data()+first;
+	std::nth_element(tris, tris+half, tris+count, [&](int a, int b) { return centroid(a) < centroid(b); });
+	BuildBvh(first, half);
+	bvh[n].first = bvh.size();
+	bvh[n].count = 0;
+	BuildBvh(first+half, count-half);
+}
+
+bool RayHitsBox(vec3 o, vec3 invDir, float tMax, const BvhNode &node) {
+	float t0 = 0, t1 = tMax;
+	for (int k = 0; k < 3; k++) {
+		float tNear = (node.min[k]-o[k])*invDir[k], tFar = (node.max[k]-o[k])*invDir[k];
+		if (tNear > tFar)
+			std::swap(tNear, tFar);
+		t0 = std::max(t0, tNear);
+		t1 = std::min(t1, tFar);
+	}
+	return t0 <= t1;
+}
+
+bool RayHitsTriangle(vec3 o, vec3 dir, float tMax, int3 tri) {
+	// Moller-Trumbore, hit if 0 < t < tMax
+	vec3 p0 = points[tri[0]], e1 = points[tri[1]]-p0, e2 = points[tri[2]]-p0;
+	vec3 q = cross(dir, e2);
+	float det = dot(e1, q);
+	if (fabs(det) < 1e-12f)
+		return false;
+	float f = 1/det;
+	vec3 s = o-p0;
+	float u = f*dot(s, q);
+	if (u < 0 || u > 1)
+		return false;
+	vec3 r = cross(s, e1);
+	float v = f*dot(dir, r), t = f*dot(e2, r);
+	return v >= 0 && u+v <= 1 && t > 0 && t < tMax;
+}
+
+bool Occluded(vec3 o, vec3 dir, float tMax) {
+	// any-hit traversal with explicit stack
+	vec3 invDir(1/dir.x, 1/dir.y, 1/dir.z);
+	int stack[64], nStack = 0;
+	stack[nStack++] = 0;
+	while (nStack) {
+		const BvhNode &node = bvh[stack[--nStack]];
+		if (!RayHitsBox(o, invDir, tMax, node))
+			continue;
+		if (node.count) {
+			for (int i = node.first; i < node.first+node.count; i++)
+				if (RayHitsTriangle(o, dir, tMax, triangles[bvhTriangles[i]]))
+					return true;
+		}
+		else {
+			stack[nStack++] = node.first;			// right child
+			stack[nStack++] = &node-bvh.data()+1;	// left child
+		}
+	}
+	return false;
+}
+
+const int maxAoPoints = 1 << 20;	// larger meshes are left unoccluded
+
+void BakeAo(int nRays = 64, float radius = .4f) {
+	// fraction of cosine-weighted hemisphere rays per vertex that escape within radius
+	double start = glfwGetTime();
+	int nTriangles = triangles.size(), nPoints = points.size();
+	if (nPoints > maxAoPoints) {
+		printf("ao not baked for %i vertices (max %i)\n", nPoints, maxAoPoints);
+		ao.assign(nPoints, 1);
+		return;
+	}
+	bvh.clear();
+	bvh.reserve(2*nTriangles/4+1);
+	bvhTriangles.resize(nTriangles);
+	for (int i = 0; i < nTriangles; i++)
+		bvhTriangles[i] = i;
+	ao.assign(nPoints, 1);
+	if (!nTriangles || normals.size() != points.size())
+		return;
+	BuildBvh(0, nTriangles);
+	TrackMemory(AoMemory, Bytes(bvh)+Bytes(bvhTriangles));
+	ParallelFor(nPoints, NThreads(nPoints, 256), [&](int t, int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			vec3 n = normalize(normals[i]);
+			// orthonormal basis around n
+			vec3 a = fabs(n.x) > .9f? vec3(0, 1, 0) : vec3(1, 0, 0);
+			vec3 b1 = normalize(cross(n, a)), b2 = cross(n, b1);
+			vec3 o = points[i]+.001f*n;
+			int nOpen = 0;
+			for (int r = 0; r < nRays; r++) {
+				// stratified over rings and golden-angle spins, cosine-weighted
+				float u = (r+.5f)/nRays, phi = 2.399963f*r+i;
+				float sinTheta = sqrt(u), cosTheta = sqrt(1-u);
+				vec3 dir = sinTheta*cos(phi)*b1+sinTheta*sin(phi)*b2+cosTheta*n;
+				if (!Occluded(o, dir, radius))
+					nOpen++;
+			}
+			ao[i] = (float) nOpen/nRays;
+		}
+	});
+	// hierarchy only needed while baking
+	vector<BvhNode>().swap(bvh);
+	vector<int>().swap(bvhTriangles);
+	TrackMemory(AoMemory, 0);
+	double dt = glfwGetTime()-start;
+	printf("ao baked for %i vertices in %3.2f secs (%3.2f M rays/sec)\n",
+		nPoints, dt, dt > 0? (double) nPoints*nRays/dt/1e6 : 0.);
+}
+
+// Mesh Arrays
+
+long long MeshBytes() {
+	// CPU memory held by the mesh arrays
+	return Bytes(points)+Bytes(normals)+Bytes(uvs)+Bytes(triangles)+Bytes(ao)+Bytes(tangents);
+}
+
+long long FileSize(FILE *file) {
+	// bytes in file, rewound to start; 64-bit on Windows too, where long is 32 bits
+#ifdef _WIN32
+	_fseeki64(file, 0, SEEK_END);
+	long long size = _ftelli64(file);
+	_fseeki64(file, 0, SEEK_SET);
+#else
+	fseeko(file, 0, SEEK_END);
+	long long size = ftello(file);
+	fseeko(file, 0, SEEK_SET);
+#endif
+	return size;
+}
+
+// Compressed Mesh File
+
+// layout: MeshHeader, then varint streams of quantized points, uvs, octahedral normals,
+// ao, and triangle indices; each stream stores the difference from the previous element
+
+struct MeshHeader {
+	char magic[4] = {'M', 'S', 'H', '1'};
+	int nPoints = 0, nUvs = 0, nNormals = 0, nAo = 0, nTriangles = 0;
+	vec3 min, max;		// point bounds
+	vec2 uvMin, uvMax;	// uv bounds
+};
+
+void PutVarint(vector<unsigned char> &buf, int v) {
+	// zigzag so small negative deltas stay short, then 7 bits per byte
+	unsigned u = ((unsigned) v << 1) ^ (unsigned) (v >> 31);
+	for (; u >= 128; u >>= 7)
+		buf.push_back((unsigned char) (u | 128));
+	buf.push_back((unsigned char) u);
+}
+
+bool GetVarint(const unsigned char *&p, const unsigned char *end, int &v) {
+	unsigned u = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		if (p == end)
+			return false;
+		unsigned char b = *p++;
+		u |= (unsigned) (b & 127) << shift;
+		if (b < 128) {
+			v = (int) (u >> 1) ^ -(int) (u & 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+void PutQuantized(vector<unsigned char> &buf, const float *f, int n, int k, const float *min, const float *max) {
+	// n elements of k floats, each float quantized to 16 bits within [min, max]
+	int prev[4] = {0, 0, 0, 0};
+	for (int i = 0; i < n; i++)
+		for (int c = 0; c < k; c++) {
+			float range = max[c]-min[c];
+			int q = range > 0? (int) ((f[k*i+c]-min[c])/range*65535+.5f) : 0;
+			PutVarint(buf, q-prev[c]);
+			prev[c] = q;
+		}
+}
+
+bool GetQuantized(const unsigned char *&p, const unsigned char *end, float *f, int n, int k, const float *min, const float *max) {
+	int prev[4] = {0, 0, 0, 0};
+	for (int i = 0; i < n; i++)
+		for (int c = 0; c < k; c++) {
+			int d;
+			if (!GetVarint(p, end, d))
+				return false;
+			prev[c] += d;
+			f[k*i+c] = min[c]+prev[c]*(max[c]-min[c])/65535;
+		}
+	return true;
+}
+
+vec2 OctEncode(vec3 n) {
+	// unit normal to [-1,1]^2 via octahedral projection
+	float s = fabs(n.x)+fabs(n.y)+fabs(n.z);
+	vec2 e(n.x/s, n.y/s);
+	if (n.z < 0)
+		e = vec2((1-fabs(e.y))*(e.x >= 0? 1 : -1), (1-fabs(e.x))*(e.y >= 0? 1 : -1));
+	return e;
+}
+
+vec3 OctDecode(vec2 e) {
+	vec3 n(e.x, e.y, 1-fabs(e.x)-fabs(e.y));
+	if (n.z < 0)
+		n = vec3((1-fabs(e.y))*(e.x >= 0? 1 : -1), (1-fabs(e.x))*(e.y >= 0? 1 : -1), n.z);
+	return normalize(n);
+}
+
+bool WriteMeshFile(const char *filename) {
+	MeshHeader h;
+	h.nPoints = points.size();
+	h.nUvs = uvs.size();
+	h.nNormals = normals.size();
+	h.nAo = ao.size();
+	h.nTriangles = triangles.size();
+	Bounds(points.data(), h.nPoints, h.min, h.max);
+	if (h.nUvs)
+		Bounds(uvs.data(), h.nUvs, h.uvMin, h.uvMax);
+	vector<vec2> octs(h.nNormals);
+	for (int i = 0; i < h.nNormals; i++)
+		octs[i] = OctEncode(normals[i]);
+	float octMin[] = {-1, -1}, octMax[] = {1, 1}, aoMin = 0, aoMax = 1;
+	vector<unsigned char> buf;
+	PutQuantized(buf, (float *) points.data(), h.nPoints, 3, &h.min.x, &h.max.x);
+	PutQuantized(buf, (float *) uvs.data(), h.nUvs, 2, &h.uvMin.x, &h.uvMax.x);
+	PutQuantized(buf, (float *) octs.data(), h.nNormals, 2, octMin, octMax);
+	PutQuantized(buf, ao.data(), h.nAo, 1, &aoMin, &aoMax);
+	const int *indices = (int *) triangles.data();
+	for (int i = 0, prev = 0; i < 3*h.nTriangles; prev = indices[i++])
+		PutVarint(buf, indices[i]-prev);
+	FILE *file = fopen(filename, "wb");
+	if (!file)
+		return false;
+	bool ok = fwrite(&h, sizeof(h), 1, file) == 1 && fwrite(buf.data(), 1, buf.size(), file) == buf.size();
+	fclose(file);
+	long long rawBytes = MeshBytes(), fileBytes = sizeof(h)+buf.size();
+	printf("%s: %lld bytes (arrays %lld bytes, %3.1f:1)\n", filename, fileBytes, rawBytes, (float) rawBytes/fileBytes);
+	if (FILE *obj = fopen(sourceFilename.c_str(), "rb")) {
+		long long objBytes = FileSize(obj);
+		fclose(obj);
+		printf("%s: %lld bytes (%3.1f:1)\n", sourceFilename.c_str(), objBytes, (float) objBytes/fileBytes);
+	}
+	return ok;
+}
+
+bool ReadMeshFile(const char *filename) {
+	double start = glfwGetTime();
+	FILE *file = fopen(filename, "rb");
+	if (!file)
+		return false;
+	MeshHeader h;
+	vector<unsigned char> buf;
+	bool ok = fread(&h, sizeof(h), 1, file) == 1 && !strncmp(h.magic, "MSH1", 4);
+	if (ok) {
+		long long size = FileSize(file)-(long long) sizeof(h);
+		fseek(file, sizeof(h), SEEK_SET);
+		buf.resize(size > 0? (size_t) size : 0);
+		ok = fread(buf.data(), 1, buf.size(), file) == buf.size();
+	}
+	fclose(file);
+	// each stream element takes at least one byte
+	ok = ok && h.nPoints >= 0 && h.nUvs >= 0 && h.nNormals >= 0 && h.nAo >= 0 && h.nTriangles >= 0 &&
+		(double) 3*h.nPoints+2*h.nUvs+2*h.nNormals+h.nAo+3.*h.nTriangles <= buf.size();
+	if (!ok)
+		return false;
+	const unsigned char *p = buf.data(), *end = p+buf.size();
+	float octMin[] = {-1, -1}, octMax[] = {1, 1}, aoMin = 0, aoMax = 1;
+	vector<vec2> octs(h.nNormals);
+	points.resize(h.nPoints);
+	uvs.resize(h.nUvs);
+	normals.resize(h.nNormals);
+	ao.resize(h.nAo);
+	triangles.resize(h.nTriangles);
+	ok = GetQuantized(p, end, (float *) points.data(), h.nPoints, 3, &h.min.x, &h.max.x) &&
+		 GetQuantized(p, end, (float *) uvs.data(), h.nUvs, 2, &h.uvMin.x, &h.uvMax.x) &&
+		 GetQuantized(p, end, (float *) octs.data(), h.nNormals, 2, octMin, octMax) &&
+		 GetQuantized(p, end, ao.data(), h.nAo, 1, &aoMin, &aoMax);
+	int *indices = (int *) triangles.data();
+	for (int i = 0, prev = 0, d; ok && i < 3*h.nTriangles; i++) {
+		ok = GetVarint(p, end, d) && (prev += d) >= 0 && prev < h.nPoints;
+		indices[i] = prev;
+	}
+	if (!ok) {
+		printf("%s is corrupt\n", filename);
+		points.clear(), uvs.clear(), normals.clear(), ao.clear(), triangles.clear();
+		return false;
+	}
+	for (int i = 0; i < h.nNormals; i++)
+		normals[i] = OctDecode(octs[i]);
+	double dt = glfwGetTime()-start;
+	printf("%s decoded in %3.3f secs (%3.1f MB/sec)\n", filename, dt, dt > 0? MeshBytes()/dt/1e6 : 0.);
+	return true;
+}
+
+// Binary PLY File
+
+enum PlyType { PlyInt8, PlyUint8, PlyInt16, PlyUint16, PlyInt32, PlyUint32, PlyFloat32, PlyFloat64, PlyBad };
+
+PlyType GetPlyType(const char *name) {
+	const char *names[][2] = { {"char", "int8"}, {"uchar", "uint8"}, {"short", "int16"}, {"ushort", "uint16"},
+							   {"int", "int32"}, {"uint", "uint32"}, {"float", "float32"}, {"double", "float64"} };
+	for (int t = 0; t < PlyBad; t++)
+		if (!strcmp(name, names[t][0]) || !strcmp(name, names[t][1]))
+			return (PlyType) t;
+	return PlyBad;
+}
+
+int PlySize(PlyType t) {
+	const int sizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+	return sizes[t];
+}
+
+double PlyValue(const unsigned char *p, PlyType t) {
+	// little-endian host assumed, as for x86 and ARM targets
+	switch (t) {
+		case PlyInt8:	 return *(const signed char *) p;
+		case PlyUint8:	 return *p;
+		case PlyInt16:	 { short v; memcpy(&v, p, 2); return v; }
+		case PlyUint16:	 { unsigned short v; memcpy(&v, p, 2); return v; }
+		case PlyInt32:	 { int v; memcpy(&v, p, 4); return v; }
+		case PlyUint32:	 { unsigned v; memcpy(&v, p, 4); return v; }
+		case PlyFloat32: { float v; memcpy(&v, p, 4); return v; }
+		default:		 { double v; memcpy(&v, p, 8); return v; }
+	}
+}
+
+struct PlyProperty {
+	string name;
+	PlyType type = PlyBad, countType = PlyBad;	// countType valid for list properties
+	int offset = 0;								// within fixed-size element, -1 if preceded by a list
+};
+
+struct PlyElement {
+	string name;
+	int count = 0, size = 0;					// size is -1 if element contains a list
+	vector<PlyProperty> properties;
+	int Find(const char *a, const char *b = "", const char *c = "") {
+		for (size_t i = 0; i < properties.size(); i++)
+			if (properties[i].name == a || properties[i].name == b || properties[i].name == c)
+				return i;
+		return -1;
+	}
+};
+
+bool ReadBinaryPly(const char *filename, vector<vec3> &pts, vector<int3> &tris, vector<vec3> &nrms, vector<vec2> &tex) {
+	FILE *file = fopen(filename, "rb");
+	if (!file)
+		return false;
+	long long fileSize = FileSize(file);
+	vector<unsigned char> buf(fileSize > 0? (size_t) fileSize : 0);
+	bool ok = fread(buf.data(), 1, buf.size(), file) == buf.size();
+	fclose(file);
+	// parse header lines up to end_header
+	vector<PlyElement> elements;
+	const unsigned char *p = buf.data(), *pEnd = p+buf.size();
+	bool binaryLE = false;
+	for (string line; ok; line.clear()) {
+		while (p < pEnd && *p != '\n')
+			line += (char) *p++;
+		if (p++ >= pEnd)
+			return false;
+		char a[100] = "", b[100] = "", c[100] = "", d[100] = "", e[100] = "";
+		int n = sscanf(line.c_str(), "%99s %99s %99s %99s %99s", a, b, c, d, e);
+		if (!strcmp(a, "format"))
+			binaryLE = !strcmp(b, "binary_little_endian");
+		else if (!strcmp(a, "element") && n == 3) {
+			elements.push_back(PlyElement());
+			elements.back().name = b;
+			elements.back().count = atoi(c);
+		}
+		else if (!strcmp(a, "property") && elements.size()) {
+			PlyElement &el = elements.back();
+			PlyProperty prop;
+			bool list = !strcmp(b, "list") && n == 5;
+			prop.name = list? e : c;
+			prop.type = GetPlyType(list? d : b);
+			prop.countType = list? GetPlyType(c) : PlyBad;
+			prop.offset = el.size;
+			if (prop.type == PlyBad || (list && prop.countType == PlyBad) || n < 3)
+				return false;
+			el.size = list || el.size < 0? -1 : el.size+PlySize(prop.type);
+			el.properties.push_back(prop);
+		}
+		else if (!strcmp(a, "end_header"))
+			break;
+	}
+	if (!ok || !binaryLE)
+		return false;
+	pts.clear(), tris.clear(), nrms.clear(), tex.clear();
+	for (PlyElement &el : elements) {
+		bool isVertex = el.name == "vertex", isFace = el.name == "face";
+		if (el.count < 0 || (isVertex && el.size < 0))
+			return false;
+		if (isVertex) {
+			int ix = el.Find("x"), iy = el.Find("y"), iz = el.Find("z");
+			int inx = el.Find("nx"), iny = el.Find("ny"), inz = el.Find("nz");
+			int iu = el.Find("u", "s", "texture_u"), iv = el.Find("v", "t", "texture_v");
+			if (ix < 0 || iy < 0 || iz < 0 || (unsigned long long) el.count*el.size > (size_t) (pEnd-p))
+				return false;
+			bool hasNormals = inx >= 0 && iny >= 0 && inz >= 0, hasUvs = iu >= 0 && iv >= 0;
+			pts.resize(el.count);
+			nrms.resize(hasNormals? el.count : 0);
+			tex.resize(hasUvs? el.count : 0);
+			bool allFloat = true;
+			for (PlyProperty &prop : el.properties)
+				allFloat = allFloat && prop.type == PlyFloat32;
+			if (allFloat && el.size == sizeof(vec3) && ix == 0 && iy == 1 && iz == 2)
+				memcpy(pts.data(), p, el.count*sizeof(vec3));	// layout matches points
+			else {
+				// convert each vertex, split across threads for large meshes
+				vector<PlyProperty> &pr = el.properties;
+				const unsigned char *base = p;
+				int size = el.size;
+				auto Get = [&](const unsigned char *v, int i) {
+					return (float) PlyValue(v+pr[i].offset, pr[i].type);
+				};
+				ParallelFor(el.count, NThreads(el.count), [&](int t, int begin, int end) {
+					for (int i = begin; i < end; i++) {
+						const unsigned char *v = base+(size_t) i*size;
+						pts[i] = vec3(Get(v, ix), Get(v, iy), Get(v, iz));
+						if (hasNormals)
+							nrms[i] = vec3(Get(v, inx), Get(v, iny), Get(v, inz));
+						if (hasUvs)
+							tex[i] = vec2(Get(v, iu), Get(v, iv));
+					}
+				});
+			}
+			p += (size_t) el.count*el.size;
+			continue;
+		}
+		// faces are fans of vertex_indices, other elements skipped
+		int iIndices = isFace? el.Find("vertex_indices", "vertex_index") : -1;
+		if (isFace)
+			tris.reserve(el.count);
+		for (int i = 0; i < el.count; i++)
+			for (int k = 0; k < (int) el.properties.size(); k++) {
+				PlyProperty &prop = el.properties[k];
+				bool list = prop.countType != PlyBad;
+				if (p+(list? PlySize(prop.countType) : PlySize(prop.type)) > pEnd)
+					return false;
+				if (!list) {
+					p += PlySize(prop.type);
+					continue;
+				}
+				int n = (int) PlyValue(p, prop.countType), s = PlySize(prop.type);
+				p += PlySize(prop.countType);
+				if (n < 0 || (unsigned long long) n*s > (size_t) (pEnd-p))
+					return false;
+				for (int j = 2; k == iIndices && j < n; j++) {
+					int3 tri((int) PlyValue(p, prop.type), (int) PlyValue(p+(j-1)*s, prop.type), (int) PlyValue(p+j*s, prop.type));
+					for (int m = 0; m < 3; m++)
+						if (tri[m] < 0 || tri[m] >= (int) pts.size())
+							return false;
+					tris.push_back(tri);
+				}
+				p += n*s;
+			}
+	}
+	return pts.size() > 0;
+}
+
+bool ReadMesh(string filename) {
+	// read binary PLY or ASCII OBJ according to suffix
+	string suffix = filename.substr(filename.rfind('.')+1);
+	for (char &c : suffix)
+		c = tolower(c);
+	double start = glfwGetTime();
+	bool ok = suffix == "ply"?
+		ReadBinaryPly(filename.c_str(), points, triangles, normals, uvs) :
+		ReadAsciiObj(filename.c_str(), points, triangles, &normals, &uvs);
+	// read time alone, for comparing formats (load time also includes ao, tangents, upload)
+	if (ok)
+		printf("%s read in %3.3f secs\n", filename.c_str(), glfwGetTime()-start);
+	return ok;
+}
+
+time_t ModifiedTime(string filename) {
+	struct stat s;
+	return stat(filename.c_str(), &s) == 0? s.st_mtime : 0;
+}
+
+// Mesh Validation
+
+struct HalfEdge {
+	unsigned long long key;		// undirected vertex pair, smaller index in high word
+	int id;						// 3*triangle+k, directed from triangles[t][k] to triangles[t][(k+1)%3]
+};
+
+void SortHalfEdges(const vector<int3> &tris, vector<HalfEdge> &h) {
+	// LSD radix sort 16 bits at a time, skipping digits that are the same for every key;
+	// each thread counts and scatters its own range, so the sort stays stable and
+	// half-edges of an edge stay in id order
+	int nTris = tris.size(), n = 3*nTris, nThreads = NThreads(n);
+	h.resize(n);
+	ParallelFor(nTris, NThreads(nTris), [&](int t, int begin, int end) {
+		for (int i = begin; i < end; i++)
+			for (int k = 0; k < 3; k++) {
+				unsigned long long a = (unsigned) tris[i][k], b = (unsigned) tris[i][(k+1)%3];
+				h[3*i+k] = {a < b? a << 32 | b : b << 32 | a, 3*i+k};
+			}
+	});
+	vector<HalfEdge> tmp(n);
+	vector<int> offsets(nThreads << 16);	// per thread, per digit
+	for (int shift = 0; n && shift < 64; shift += 16) {
+		std::fill(offsets.begin(), offsets.end(), 0);
+		ParallelFor(n, nThreads, [&](int t, int begin, int end) {
+			int *o = &offsets[t << 16];
+			for (int i = begin; i < end; i++)
+				o[(h[i].key >> shift) & 0xffff]++;
+		});
+		int digit = (h[0].key >> shift) & 0xffff, nDigit = 0;
+		for (int t = 0; t < nThreads; t++)
+			nDigit += offsets[(t << 16)+digit];
+		if (nDigit == n)
+			continue;
+		// digit-major, thread-minor prefix sum: earlier threads scatter first within a digit
+		for (int d = 0, sum = 0; d < (1 << 16); d++)
+			for (int t = 0; t < nThreads; t++) {
+				int &o = offsets[(t << 16)+d], count = o;
+				o = sum;
+				sum += count;
+			}
+		ParallelFor(n, nThreads, [&](int t, int begin, int end) {
+			int *o = &offsets[t << 16];
+			for (int i = begin; i < end; i++)
+				tmp[o[(h[i].key >> shift) & 0xffff]++] = h[i];
+		});
+		h.swap(tmp);
+	}
+}
+
+struct CornerTable {
+	// edge adjacency for a triangle list, indexed by half-edge (corner) id 3*t+k
+	vector<HalfEdge> sorted;	// half-edges grouped by edge
+	vector<int> edgeStart;		// edge e has sorted[edgeStart[e]] to sorted[edgeStart[e+1]-1]
+	vector<int> edges;			// edge of each half-edge
+	vector<int> opposite;		// other half-edge of its edge, -1 if boundary or non-manifold
+	int NEdges() const { return edgeStart.size()-1; }
+	int Count(int e) const { return edgeStart[e+1]-edgeStart[e]; }
+};
+
+void BuildCornerTable(const vector<int3> &tris, CornerTable &c) {
+	SortHalfEdges(tris, c.sorted);
+	int n = c.sorted.size();
+	c.edgeStart.clear();
+	c.edges.resize(n);
+	c.opposite.assign(n, -1);
+	for (int i = 0; i < n; i++) {
+		if (i == 0 || c.sorted[i].key != c.sorted[i-1].key)
+			c.edgeStart.push_back(i);
+		c.edges[c.sorted[i].id] = c.edgeStart.size()-1;
+	}
+	c.edgeStart.push_back(n);
+	for (int e = 0; e < c.NEdges(); e++)
+		if (c.Count(e) == 2) {
+			int a = c.sorted[c.edgeStart[e]].id, b = c.sorted[c.edgeStart[e]+1].id;
+			c.opposite[a] = b;
+			c.opposite[b] = a;
+		}
+}
+
+void CheckMesh() {
+	// report boundary and non-manifold edges, inconsistent windings,
+	// duplicate and degenerate triangles
+	double start = glfwGetTime();
+	CornerTable c;
+	BuildCornerTable(triangles, c);
+	int nEdges = c.NEdges(), nBoundary = 0, nNonManifold = 0, nFlipped = 0;
+	for (int e = 0; e < nEdges; e++)
+		if (c.Count(e) == 1)
+			nBoundary++;
+		else if (c.Count(e) > 2)
+			nNonManifold++;
+	for (int a = 0; a < (int) c.opposite.size(); a++) {
+		int b = c.opposite[a];
+		if (b > a && triangles[a/3][a%3] == triangles[b/3][b%3])
+			nFlipped++;		// both triangles traverse edge in same direction
+	}
+	// same three vertices in any order
+	int nTris = triangles.size(), nDegenerate = 0, nDuplicate = 0;
+	vector<int3> sorted(triangles);
+	for (int3 &t : sorted) {
+		std::sort(&t[0], &t[0]+3);
+		if (t[0] == t[1] || t[1] == t[2])
+			nDegenerate++;
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const int3 &a, const int3 &b) {
+		return a[0] != b[0]? a[0] < b[0] : a[1] != b[1]? a[1] < b[1] : a[2] < b[2];
+	});
+	for (int i = 1; i < nTris; i++)
+		if (sorted[i][0] == sorted[i-1][0] && sorted[i][1] == sorted[i-1][1] && sorted[i][2] == sorted[i-1][2])
+			nDuplicate++;
+	double dt = glfwGetTime()-start;
+	printf("mesh check: %i edges, %i boundary, %i non-manifold, %i inconsistently wound, ", nEdges, nBoundary, nNonManifold, nFlipped);
+	printf("%i duplicate, %i degenerate triangles (%3.2f secs, %3.1f M triangles/sec)\n",
+		nDuplicate, nDegenerate, dt, dt > 0? nTris/dt/1e6 : 0.);
+}
+
+// Tangents
+
+void ComputeTangents() {
+	// tangent per triangle from its uv gradient, corner-angle weighted sum per vertex,
+	// orthogonalized against the vertex normal; vertices shared by triangles with opposite
+	// uv orientation (mirrored uvs) are split so each copy has one handedness
+	double start = glfwGetTime();
+	int nTris = triangles.size(), nPoints = points.size();
+	tangents.clear();
+	if (uvs.size() != points.size() || normals.size() != points.size())
+		return;
+	vector<vec3> triTangents(nTris);
+	vector<float> triSigns(nTris);
+	ParallelFor(nTris, NThreads(nTris), [&](int t, int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			int3 tri = triangles[i];
+			vec3 e1 = points[tri[1]]-points[tri[0]], e2 = points[tri[2]]-points[tri[0]];
+			vec2 d1 = uvs[tri[1]]-uvs[tri[0]], d2 = uvs[tri[2]]-uvs[tri[0]];
+			float det = d1.x*d2.y-d2.x*d1.y, sign = det < 0? -1.f : 1.f;
+			vec3 tan = sign*(d2.y*e1-d1.y*e2);	// direction of increasing u
+			float len = length(tan);
+			triTangents[i] = len > 0? tan/len : vec3(0, 0, 0);
+			triSigns[i] = sign;
+		}
+	});
+	// split vertices used with both handedness, giving copies to mirrored triangles
+	vector<char> usedRight(nPoints, 0);
+	for (int t = 0; t < nTris; t++)
+		for (int k = 0; k < 3 && triSigns[t] > 0; k++)
+			usedRight[triangles[t][k]] = 1;
+	vector<int> copies(nPoints, -1);
+	bool hasAo = ao.size() == points.size();
+	for (int t = 0; t < nTris; t++)
+		for (int k = 0; k < 3 && triSigns[t] < 0; k++) {
+			int v = triangles[t][k];
+			if (!usedRight[v])
+				continue;
+			if (copies[v] < 0) {
+				copies[v] = points.size();
+				points.push_back(points[v]);
+				normals.push_back(normals[v]);
+				uvs.push_back(uvs[v]);
+				if (hasAo)
+					ao.push_back(ao[v]);
+			}
+			triangles[t][k] = copies[v];
+		}
+	int nSplit = points.size()-nPoints;
+	nPoints = points.size();
+	// triangle corners incident on each vertex
+	vector<int> firstCorner(nPoints+1, 0), corners(3*nTris);
+	for (int c = 0; c < 3*nTris; c++)
+		firstCorner[triangles[c/3][c%3]+1]++;
+	for (int v = 0; v < nPoints; v++)
+		firstCorner[v+1] += firstCorner[v];
+	vector<int> fill(firstCorner.begin(), firstCorner.end()-1);
+	for (int c = 0; c < 3*nTris; c++)
+		corners[fill[triangles[c/3][c%3]]++] = c;
+	tangents.resize(nPoints);
+	ParallelFor(nPoints, NThreads(nPoints), [&](int t, int begin, int end) {
+		for (int v = begin; v < end; v++) {
+			vec3 sum(0, 0, 0), n = normalize(normals[v]);
+			float w = 1;
+			for (int j = firstCorner[v]; j < firstCorner[v+1]; j++) {
+				int c = corners[j], tri = c/3, k = c%3;
+				vec3 a = points[triangles[tri][(k+1)%3]]-points[v], b = points[triangles[tri][(k+2)%3]]-points[v];
+				float la = length(a), lb = length(b);
+				float angle = la > 0 && lb > 0? acos(std::max(-1.f, std::min(1.f, dot(a, b)/(la*lb)))) : 0;
+				sum += angle*triTangents[tri];
+				w = triSigns[tri];
+			}
+			vec3 tan = sum-dot(sum, n)*n;
+			if (length(tan) < 1e-6f)	// no uv gradient: any direction perpendicular to n
+				tan = cross(n, fabs(n.x) > .9f? vec3(0, 1, 0) : vec3(1, 0, 0));
+			tan = normalize(tan);
+			tangents[v] = vec4(tan.x, tan.y, tan.z, w);
+		}
+	});
+	double dt = glfwGetTime()-start;
+	printf("tangents for %i vertices (%i split) in %3.3f secs (%3.1f M triangles/sec)\n",
+		nPoints, nSplit, dt, dt > 0? nTris/dt/1e6 : 0.);
+}
+
+// Procedural Torus
+
+void MakeTorus(int nRings, int nSides, float R = 1, float r = .4f) {
+	// ring radius R about z-axis, tube radius r, analytic normals and uvs
+	// (nRings+1)*(nSides+1) vertices, so uvs run 0 to 1 across the seams
+	double start = glfwGetTime();
+	int nu = nRings+1, nv = nSides+1;
+	// angles tabulated once, not per vertex
+	vector<float> cosU(nu), sinU(nu), cosV(nv), sinV(nv);
+	for (int i = 0; i < nu; i++) {
+		float a = 2*3.1415927f*i/nRings;
+		cosU[i] = cos(a);
+		sinU[i] = sin(a);
+	}
+	for (int j = 0; j < nv; j++) {
+		float a = 2*3.1415927f*j/nSides;
+		cosV[j] = cos(a);
+		sinV[j] = sin(a);
+	}
+	points.resize(nu*nv);
+	normals.resize(nu*nv);
+	uvs.resize(nu*nv);
+	triangles.resize(2*nRings*nSides);
+	ParallelFor(nu, std::min(nu, NThreads(nu*nv)), [&](int t, int begin, int end) {
+		for (int i = begin; i < end; i++)
+			for (int j = 0; j < nv; j++) {
+				int k = i*nv+j;
+				vec3 n(cosU[i]*cosV[j], sinU[i]*cosV[j], sinV[j]);
+				normals[k] = n;
+				points[k] = vec3(R*cosU[i], R*sinU[i], 0)+r*n;
+				uvs[k] = vec2((float) i/nRings, (float) j/nSides);
+				if (i < nRings && j < nSides) {
+					// ccw seen from outside
+					int a = k, b = k+nv, c = k+nv+1, d = k+1;
+					triangles[2*(i*nSides+j)] = int3(a, b, c);
+					triangles[2*(i*nSides+j)+1] = int3(a, c, d);
+				}
+			}
+	});
+	printf("torus: %i triangles generated in %3.3f secs\n", (int) triangles.size(), glfwGetTime()-start);
+}
+
+void CheckTorusTangents() {
+	// generated torus (centered on the z-axis, also after standardizing): u runs around the
+	// ring, so the exact tangent is the ring direction and the exact bitangent cross(n, tangent)
+	float maxAngle = 0;
+	int nFlipped = 0;
+	for (size_t i = 0; i < points.size() && i < tangents.size(); i++) {
+		vec3 p = points[i], n = normalize(normals[i]), t(tangents[i].x, tangents[i].y, tangents[i].z);
+		vec3 ring = normalize(vec3(-p.y, p.x, 0));
+		maxAngle = std::max(maxAngle, acos(std::max(-1.f, std::min(1.f, dot(t, ring)))));
+		if (tangents[i].w*dot(cross(n, t), cross(n, ring)) <= 0)
+			nFlipped++;
+	}
+	printf("torus tangents: %3.2f degrees max from analytic, %i with wrong handedness\n",
+		maxAngle*180/3.1415927f, nFlipped);
+}
+
 // Initialization
 
+GLuint ReadMipmappedTexture(const char *filename) {
+	// trilinear filtering: a minified texture is sampled from the mip level nearest its
+	// screen size, so neighboring pixels read neighboring, cached texels
+	GLuint name = ReadTexture(filename);
+	if (name) {
+		glBindTexture(GL_TEXTURE_2D, name);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	return name;
+}
+
+long long TextureBytes(GLuint name) {
+	// all mip levels, at 4 bytes per texel (drivers commonly pad RGB8 to RGBA8)
+	long long bytes = 0;
+	if (!name)
+		return 0;
+	glBindTexture(GL_TEXTURE_2D, name);
+	for (int level = 0; ; level++) {
+		int w = 0, h = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &w);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &h);
+		if (!w || !h)
+			break;
+		bytes += 4LL*w*h;
+	}
+	return bytes;
+}
+
+void TrackTextures() {
+	TrackMemory(TextureMemory, TextureBytes(textureName)+TextureBytes(normalMapName));
+	sentTextures.program = 0;	// bindings changed above
+}
+
 void BufferVertices() {
-	// create GPU buffer, make it active
-	glGenBuffers(1, &vBuffer);
+	// create GPU buffer if needed, make it active
+	if (!vBuffer)
+		glGenBuffers(1, &vBuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, vBuffer);
-	// allocate/load memory for points and uvs
-	int sPoints = sizeof(points), sUvs = sizeof(uvs), sNormals = sizeof(normals);
-	glBufferData(GL_ARRAY_BUFFER, sPoints+sUvs, NULL, GL_STATIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, points.size() * sizeof(vec3), points.data());
-	glBufferSubData(GL_ARRAY_BUFFER, points.size() * sizeof(vec3), uvs.size() * sizeof(vec2), uvs.data());
-	glBufferSubData(GL_ARRAY_BUFFER, points.size() * sizeof(vec3) + uvs.size() * sizeof(vec2), normals.size() * sizeof(vec3), normals.data());
+	// allocate/load memory for points, uvs and normals
+	int sPoints = points.size()*sizeof(vec3), sUvs = uvs.size()*sizeof(vec2), sNormals = normals.size()*sizeof(vec3);
+	int sAo = ao.size()*sizeof(float), sTangents = tangents.size()*sizeof(vec4);
+	glBufferData(GL_ARRAY_BUFFER, sPoints+sUvs+sNormals+sAo+sTangents, NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sPoints, points.data());
+	glBufferSubData(GL_ARRAY_BUFFER, sPoints, sUvs, uvs.data());
+	glBufferSubData(GL_ARRAY_BUFFER, sPoints+sUvs, sNormals, normals.data());
+	glBufferSubData(GL_ARRAY_BUFFER, sPoints+sUvs+sNormals, sAo, ao.data());
+	glBufferSubData(GL_ARRAY_BUFFER, sPoints+sUvs+sNormals+sAo, sTangents, tangents.data());
+	uvOffset = sPoints;
+	normalOffset = sPoints+sUvs;
+	aoOffset = sPoints+sUvs+sNormals;
+	tangentOffset = sTangents? sPoints+sUvs+sNormals+sAo : 0;
+	nBufferedIndices = 3*triangles.size();
+	// triangles stay resident on GPU rather than sent from client memory each draw
+	if (!eBuffer)
+		glGenBuffers(1, &eBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangles.size()*sizeof(int3), triangles.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // annotation draws from client memory
+	layoutChanged = true;
+	TrackMemory(BufferMemory, (long long) sPoints+sUvs+sNormals+sAo+sTangents+triangles.size()*sizeof(int3));
+}
+
+void LoadMesh() {
+	// runs on loader thread: generate torus, or read compressed mesh if present, else read OBJ,
+	// fit points to +/- .8 space, supply missing normals, bake occlusion
+	if (torusRings > 0)
+		MakeTorus(torusRings, std::max(3, torusRings/2));
+	else if (ModifiedTime(meshFilename) >= ModifiedTime(sourceFilename) &&
+		ReadMeshFile(meshFilename.c_str()) && ao.size() == points.size()) {
+		ComputeTangents();
+		TrackMemory(MeshMemory, MeshBytes());
+		meshStatus = 1;
+		return;
+	}
+	if (!points.size() && !ReadMesh(sourceFilename)) {
+		meshStatus = -1;
+		return;
+	}
+	TrackMemory(MeshMemory, MeshBytes());
+	CheckMesh();
+	if (compareStandardize)
+		CompareStandardize(points, .8f);
+	else
+		StandardizePoints(points, .8f);
+	if (normals.size() != points.size())
+		SetVertexNormals(points, triangles, normals);
+	BakeAo();
+	ComputeTangents();
+	if (torusRings > 0)
+		CheckTorusTangents();
+	// arrays grown by push_back may hold up to twice their size
+	long long grownBytes = MeshBytes();
+	TrackMemory(MeshMemory, grownBytes);
+	points.shrink_to_fit();
+	normals.shrink_to_fit();
+	uvs.shrink_to_fit();
+	ao.shrink_to_fit();
+	tangents.shrink_to_fit();
+	triangles.shrink_to_fit();
+	printf("mesh arrays trimmed from %lld to %lld bytes\n", grownBytes, MeshBytes());
+	TrackMemory(MeshMemory, MeshBytes());
+	meshStatus = 1;
+}
+
+// Loop Subdivision
+
+// refined vertices are fixed linear combinations of control vertices, so each level's
+// weights are stored once per topology as sparse rows; re-evaluating after the control
+// points change is a sparse matrix-vector product
+
+struct StencilTable {
+	int nControl = 0;		// vertices in coarser level
+	vector<int> rows;		// refined vertex i uses terms rows[i] to rows[i+1]-1
+	vector<int> indices;	// coarse vertex per term
+	vector<float> weights;	// weight per term
+	vector<int3> triangles; // refined triangles
+	void Add(int i, float w) { indices.push_back(i); weights.push_back(w); }
+	void EndRow() { rows.push_back(indices.size()); }
+};
+
+void BuildLoopStencils(const vector<int3> &tris, int nControl, StencilTable &st) {
+	// group triangle corners by edge
+	int nTris = tris.size();
+	CornerTable ct;
+	BuildCornerTable(tris, ct);
+	int nEdges = ct.NEdges();
+	// per-vertex neighbors, boundary neighbors (edges with one triangle or non-manifold)
+	vector<vector<int>> neighbors(nControl), boundaryNeighbors(nControl);
+	for (int e = 0; e < nEdges; e++) {
+		int h = ct.sorted[ct.edgeStart[e]].id, a = tris[h/3][h%3], b = tris[h/3][(h%3+1)%3];
+		neighbors[a].push_back(b);
+		neighbors[b].push_back(a);
+		if (ct.opposite[h] < 0) {
+			boundaryNeighbors[a].push_back(b);
+			boundaryNeighbors[b].push_back(a);
+		}
+	}
+	st = StencilTable();
+	st.nControl = nControl;
+	st.rows.push_back(0);
+	// even vertices: repositioned control vertices
+	for (int i = 0; i < nControl; i++) {
+		vector<int> &nb = neighbors[i], &bnb = boundaryNeighbors[i];
+		int n = nb.size();
+		if (bnb.size() == 2) {
+			st.Add(i, .75f);
+			st.Add(bnb[0], .125f);
+			st.Add(bnb[1], .125f);
+		}
+		else if (bnb.size() || n < 3)
+			st.Add(i, 1);	// corner or non-manifold vertex stays put
+		else {
+			float beta = n == 3? 3.f/16 : 3.f/(8*n);
+			st.Add(i, 1-n*beta);
+			for (int j : nb)
+				st.Add(j, beta);
+		}
+		st.EndRow();
+	}
+	// odd vertices: one per edge
+	for (int e = 0; e < nEdges; e++) {
+		int h = ct.sorted[ct.edgeStart[e]].id, o = ct.opposite[h], a = tris[h/3][h%3], b = tris[h/3][(h%3+1)%3];
+		if (o < 0) {
+			st.Add(a, .5f);
+			st.Add(b, .5f);
+		}
+		else {
+			// interior edge: the vertices opposite it in its two triangles
+			st.Add(a, .375f);
+			st.Add(b, .375f);
+			st.Add(tris[h/3][(h%3+2)%3], .125f);
+			st.Add(tris[o/3][(o%3+2)%3], .125f);
+		}
+		st.EndRow();
+	}
+	// each triangle becomes four
+	st.triangles.resize(4*nTris);
+	for (int t = 0; t < nTris; t++) {
+		int a = tris[t][0], b = tris[t][1], c = tris[t][2];
+		int ab = nControl+ct.edges[3*t], bc = nControl+ct.edges[3*t+1], ca = nControl+ct.edges[3*t+2];
+		st.triangles[4*t] = int3(a, ab, ca);
+		st.triangles[4*t+1] = int3(ab, b, bc);
+		st.triangles[4*t+2] = int3(ca, bc, c);
+		st.triangles[4*t+3] = int3(ab, bc, ca);
+	}
+}
+
+void ApplyStencils(const StencilTable &st, const float *src, float *dst, int k) {
+	// dst[i] = sum of weights * src over row i, for elements of k floats
+	int nRows = st.rows.size()-1;
+	ParallelFor(nRows, NThreads(nRows, 1 << 14), [&](int t, int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			float sum[3] = {0, 0, 0};
+			for (int j = st.rows[i]; j < st.rows[i+1]; j++)
+				for (int c = 0; c < k; c++)
+					sum[c] += st.weights[j]*src[k*st.indices[j]+c];
+			for (int c = 0; c < k; c++)
+				dst[k*i+c] = sum[c];
+		}
+	});
+}
+
+template<class T> void Refine(const StencilTable &st, const vector<T> &src, vector<T> &dst) {
+	// T is float, vec2 or vec3; arrays not matching the control vertex count are dropped
+	dst.resize(src.size() == (size_t) st.nControl? st.rows.size()-1 : 0);
+	if (dst.size())
+		ApplyStencils(st, (const float *) src.data(), (float *) dst.data(), sizeof(T)/sizeof(float));
+}
+
+// control mesh and cached stencils for each level
+vector<vec3> ctrlPoints, ctrlNormals;
+vector<vec2> ctrlUvs;
+vector<float> ctrlAo;
+vector<int3> ctrlTriangles;
+vector<StencilTable> levels;
+int subdivisionLevel = 0;
+const int maxSubdivisionLevel = 4;
+
+void EvaluateSubdivision() {
+	// recompute points, normals, uvs, ao for current level from control mesh
+	double start = glfwGetTime();
+	points = ctrlPoints, normals = ctrlNormals, uvs = ctrlUvs, ao = ctrlAo, triangles = ctrlTriangles;
+	for (int l = 0; l < subdivisionLevel; l++) {
+		vector<vec3> p, n;
+		vector<vec2> u;
+		vector<float> a;
+		Refine(levels[l], points, p);
+		Refine(levels[l], normals, n);
+		Refine(levels[l], uvs, u);
+		Refine(levels[l], ao, a);
+		points.swap(p), normals.swap(n), uvs.swap(u), ao.swap(a);
+		triangles = levels[l].triangles;
+	}
+	for (vec3 &n : normals)
+		n = normalize(n);
+	ComputeTangents();
+	printf("level %i: %i triangles, evaluated in %3.3f secs\n",
+		subdivisionLevel, (int) triangles.size(), glfwGetTime()-start);
+}
+
+void SetSubdivisionLevel(int level) {
+	level = std::max(0, std::min(maxSubdivisionLevel, level));
+	if (level == subdivisionLevel)
+		return;
+	// control mesh is copied once per loaded mesh; PollFiles clears levels when the mesh changes
+	if (levels.empty())
+		ctrlPoints = points, ctrlNormals = normals, ctrlUvs = uvs, ctrlAo = ao, ctrlTriangles = triangles;
+	// build stencils for levels not yet cached
+	while ((int) levels.size() < level) {
+		double start = glfwGetTime();
+		int l = levels.size();
+		const vector<int3> &tris = l? levels[l-1].triangles : ctrlTriangles;
+		int nControl = l? levels[l-1].rows.size()-1 : ctrlPoints.size();
+		levels.push_back(StencilTable());
+		BuildLoopStencils(tris, nControl, levels.back());
+		printf("level %i stencils built in %3.3f secs\n", l+1, glfwGetTime()-start);
+	}
+	subdivisionLevel = level;
+	EvaluateSubdivision();
+	BufferVertices();
+	long long bytes = Bytes(ctrlPoints)+Bytes(ctrlNormals)+Bytes(ctrlUvs)+Bytes(ctrlAo)+Bytes(ctrlTriangles);
+	for (StencilTable &st : levels)
+		bytes += Bytes(st.rows)+Bytes(st.indices)+Bytes(st.weights)+Bytes(st.triangles);
+	TrackMemory(SubdivisionMemory, bytes);
+	TrackMemory(MeshMemory, MeshBytes());
+}
+
+// Hot Reload
+
+// shaders are read from these files if present, else compiled from the strings above
+const char *vertexShaderFile = "Assignment-5.vert", *pixelShaderFile = "Assignment-5.frag";
+time_t sourceTime = 0, textureTime = 0, vertexShaderTime = 0, pixelShaderTime = 0;
+double lastPoll = 0, reloadStart = 0;	// reloadStart non-zero until reload is shown
+
+// mesh as buffered, kept during reload to restore on failure and to find changed ranges
+vector<vec3> prevPoints, prevNormals;
+vector<vec2> prevUvs;
+vector<float> prevAo;
+vector<vec4> prevTangents;
+vector<int3> prevTriangles;
+
+bool MeshIdle() {
+	// true if render thread owns mesh arrays
+	return meshBuffered && !loader.joinable();
+}
+
+bool Changed(string filename, time_t &time) {
+	// true if file modified since time, which is then updated
+	time_t t = ModifiedTime(filename);
+	bool changed = t != time;
+	time = t;
+	return changed;
+}
+
+bool ReadText(const char *filename, string &text) {
+	FILE *file = fopen(filename, "rb");
+	if (!file)
+		return false;
+	text.clear();
+	for (int c; (c = fgetc(file)) != EOF; )
+		text += (char) c;
+	fclose(file);
+	return true;
+}
+
+void SetShadingUniforms() {
+	// uniforms otherwise only set on key press
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "useFacetedNormal"), useFacetedNormal);
+	glUniform1f(glGetUniformLocation(program, "ambientValue"), ambientValue);
+	glUniform1f(glGetUniformLocation(program, "diffuseValue"), diffuseValue);
+	glUniform1f(glGetUniformLocation(program, "specularValue"), specularValue);
+	glUniform1f(glGetUniformLocation(program, "shininessValue"), shininessValue);
+}
+
+void LinkShaders() {
+	string vCode = vertexShader, pCode = pixelShader, code;
+	if (ReadText(vertexShaderFile, code))
+		vCode = code;
+	if (ReadText(pixelShaderFile, code))
+		pCode = code;
+	const char *v = vCode.c_str(), *p = pCode.c_str();
+	GLuint newProgram = LinkProgramViaCode(&v, &p);
+	if (!newProgram) {
+		printf("shaders not linked, previous program kept\n");
+		return;
+	}
+	if (program)
+		glDeleteProgram(program);
+	program = newProgram;
+	layoutChanged = true;	// attribute locations may differ
+	sentView.program = sentTextures.program = 0;	// new program may reuse the old id
+	SetShadingUniforms();
+}
+
+template<class T> int UploadChanges(GLenum target, size_t offset, const vector<T> &now, const vector<T> &was) {
+	// upload span from first to last differing element, return bytes uploaded
+	int n = now.size(), first = 0, last = n-1;
+	while (first < n && !memcmp(&now[first], &was[first], sizeof(T)))
+		first++;
+	if (first == n)
+		return 0;
+	while (last > first && !memcmp(&now[last], &was[last], sizeof(T)))
+		last--;
+	int bytes = (last-first+1)*sizeof(T);
+	glBufferSubData(target, offset+first*sizeof(T), bytes, &now[first]);
+	return bytes;
+}
+
+void SwapPrevious() {
+	points.swap(prevPoints), normals.swap(prevNormals), uvs.swap(prevUvs), ao.swap(prevAo), tangents.swap(prevTangents);
+	triangles.swap(prevTriangles);
+	TrackMemory(MeshMemory, MeshBytes());
+	TrackMemory(ReloadMemory, Bytes(prevPoints)+Bytes(prevNormals)+Bytes(prevUvs)+Bytes(prevAo)+
+							  Bytes(prevTangents)+Bytes(prevTriangles));
+}
+
+void ReleasePrevious() {
+	vector<vec3>().swap(prevPoints), vector<vec3>().swap(prevNormals), vector<vec2>().swap(prevUvs);
+	vector<float>().swap(prevAo), vector<vec4>().swap(prevTangents), vector<int3>().swap(prevTriangles);
+	TrackMemory(ReloadMemory, 0);
+}
+
+void UpdateBuffers() {
+	// after reload: if array sizes unchanged, re-upload changed ranges only
+	int fullBytes = points.size()*sizeof(vec3)+normals.size()*sizeof(vec3)+uvs.size()*sizeof(vec2)+
+					ao.size()*sizeof(float)+tangents.size()*sizeof(vec4)+triangles.size()*sizeof(int3), bytes = fullBytes;
+	if (points.size() != prevPoints.size() || normals.size() != prevNormals.size() || uvs.size() != prevUvs.size() ||
+		ao.size() != prevAo.size() || tangents.size() != prevTangents.size() || triangles.size() != prevTriangles.size())
+		BufferVertices();
+	else {
+		glBindBuffer(GL_ARRAY_BUFFER, vBuffer);
+		bytes = UploadChanges(GL_ARRAY_BUFFER, 0, points, prevPoints)+
+				UploadChanges(GL_ARRAY_BUFFER, uvOffset, uvs, prevUvs)+
+				UploadChanges(GL_ARRAY_BUFFER, normalOffset, normals, prevNormals)+
+				UploadChanges(GL_ARRAY_BUFFER, aoOffset, ao, prevAo)+
+				UploadChanges(GL_ARRAY_BUFFER, tangentOffset, tangents, prevTangents);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eBuffer);
+		bytes += UploadChanges(GL_ELEMENT_ARRAY_BUFFER, 0, triangles, prevTriangles);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+	ReleasePrevious();
+	printf("%s reloaded: %i of %i bytes uploaded\n", sourceFilename.c_str(), bytes, fullBytes);
+}
+
+void PollFiles() {
+	// twice a second, reload changed shaders and texture, start re-read of changed mesh
+	double now = glfwGetTime();
+	if (now-lastPoll < .5)
+		return;
+	lastPoll = now;
+	bool vChanged = Changed(vertexShaderFile, vertexShaderTime), pChanged = Changed(pixelShaderFile, pixelShaderTime);
+	if (vChanged || pChanged) {
+		reloadStart = now;
+		LinkShaders();
+	}
+	if (Changed(textFilename, textureTime)) {
+		reloadStart = now;
+		if (GLuint t = ReadMipmappedTexture(textFilename)) {
+			glDeleteTextures(1, &textureName);
+			textureName = t;
+			TrackTextures();
+		}
+	}
+	if (torusRings == 0 && MeshIdle() && Changed(sourceFilename, sourceTime)) {
+		reloadStart = now;
+		// loader refills mesh arrays; buffered copy stays in use meanwhile
+		subdivisionLevel = 0;
+		vector<StencilTable>().swap(levels);
+		vector<vec3>().swap(ctrlPoints), vector<vec3>().swap(ctrlNormals);
+		vector<vec2>().swap(ctrlUvs), vector<float>().swap(ctrlAo), vector<int3>().swap(ctrlTriangles);
+		TrackMemory(SubdivisionMemory, 0);
+		SwapPrevious();
+		meshStatus = 0;
+		loader = std::thread(LoadMesh);
+	}
+}
 
+void ReloadShown() {
+	// called after swap
+	if (reloadStart > 0 && MeshIdle()) {
+		printf("reload visible in %3.3f secs\n", glfwGetTime()-reloadStart);
+		reloadStart = 0;
+	}
+}
+
+bool UpdateMesh() {
+	// called each frame by render thread: buffer mesh once loader is done; false if first load failed
+	if (meshStatus == 0 || (meshBuffered && !loader.joinable()))
+		return true;
+	if (loader.joinable())	// not started if mesh was read with -blocking
+		loader.join();
+	if (meshStatus < 0) {
+		printf("can't read %s\n", sourceFilename.c_str());
+		if (!meshBuffered)
+			return false;
+		SwapPrevious();	// keep buffered mesh
+		ReleasePrevious();
+		meshStatus = 1;
+		return true;
+	}
+	if (meshBuffered) {
+		UpdateBuffers();
+		return true;
+	}
+	BufferVertices();
+	meshBuffered = true;
+	printf("%s: %i points, %i triangles, loaded in %3.2f secs\n",
+		sourceFilename.c_str(), (int) points.size(), (int) triangles.size(), glfwGetTime()-loadStart);
+	return true;
+}
+
+// Golden Image
+
+// with "-golden file.ppm", once the mesh is buffered draw goldenFrames frames, then compare the
+// last with file and the median draw time with file.time (recording either if absent)
+string goldenFilename;
+const int goldenFrames = 60;
+const float pixelTolerance = .03f;		// luminance difference for a pixel to count as changed
+const float areaTolerance = .001f;		// fraction of changed pixels allowed
+const float timeTolerance = 1.25f;		// allowed ratio of median draw time to baseline
+vector<double> drawTimes;
+
+void ReadFramebuffer(int &width, int &height, vector<unsigned char> &rgb) {
+	// back buffer as RGB rows, top row first
+	int viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	width = viewport[2], height = viewport[3];
+	vector<unsigned char> flipped(3*width*height);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, flipped.data());
+	rgb.resize(flipped.size());
+	for (int y = 0; y < height; y++)
+		memcpy(&rgb[3*width*y], &flipped[3*width*(height-1-y)], 3*width);
+}
+
+bool WritePpm(const char *filename, int width, int height, const vector<unsigned char> &rgb) {
+	FILE *out = fopen(filename, "wb");
+	if (!out)
+		return false;
+	fprintf(out, "P6\n%i %i\n255\n", width, height);
+	bool ok = fwrite(rgb.data(), 1, rgb.size(), out) == rgb.size();
+	fclose(out);
+	return ok;
+}
+
+bool ReadPpm(const char *filename, int &width, int &height, vector<unsigned char> &rgb) {
+	FILE *in = fopen(filename, "rb");
+	if (!in)
+		return false;
+	int maxValue = 0;
+	bool ok = fscanf(in, "P6 %i %i %i", &width, &height, &maxValue) == 3 && maxValue == 255 &&
+			  width > 0 && height > 0 && fgetc(in) != EOF;
+	if (ok) {
+		rgb.resize(3*width*height);
+		ok = fread(rgb.data(), 1, rgb.size(), in) == rgb.size();
+	}
+	fclose(in);
+	return ok;
+}
+
+bool CheckDrawTime() {
+	// true if median draw time is within baseline, or baseline recorded
+	std::sort(drawTimes.begin(), drawTimes.end());
+	double median = drawTimes[drawTimes.size()/2], baseline = 0;
+	string timeFilename = goldenFilename+".time";
+	FILE *timeFile = fopen(timeFilename.c_str(), "r");
+	if (!timeFile) {
+		bool written = (timeFile = fopen(timeFilename.c_str(), "w")) != NULL;
+		if (written) {
+			fprintf(timeFile, "%f\n", median);
+			fclose(timeFile);
+		}
+		printf("%s draw time baseline %3.2f ms in %s\n", written? "recorded" : "FAIL: can't record", 1000*median, timeFilename.c_str());
+		return written;
+	}
+	bool ok = fscanf(timeFile, "%lf", &baseline) == 1 && median <= timeTolerance*baseline;
+	fclose(timeFile);
+	printf("%s: median draw %3.2f ms, baseline %3.2f ms\n", ok? "pass" : "FAIL", 1000*median, 1000*baseline);
+	return ok;
+}
+
+bool CheckImage() {
+	// true if frame matches golden image, or golden image recorded
+	int width, height, goldenWidth, goldenHeight;
+	vector<unsigned char> rgb, golden;
+	ReadFramebuffer(width, height, rgb);
+	if (!ReadPpm(goldenFilename.c_str(), goldenWidth, goldenHeight, golden)) {
+		bool written = WritePpm(goldenFilename.c_str(), width, height, rgb);
+		printf("%s %s\n", written? "recorded golden image" : "FAIL: can't write", goldenFilename.c_str());
+		return written;
+	}
+	if (goldenWidth != width || goldenHeight != height) {
+		printf("FAIL: frame is %ix%i, golden image %ix%i\n", width, height, goldenWidth, goldenHeight);
+		return false;
+	}
+	// compare luminance, so small color shifts of equal brightness are tolerated
+	int nChanged = 0;
+	for (int i = 0; i < width*height; i++) {
+		const unsigned char *a = &rgb[3*i], *b = &golden[3*i];
+		float d = .299f*(a[0]-b[0])+.587f*(a[1]-b[1])+.114f*(a[2]-b[2]);
+		if (fabs(d) > 255*pixelTolerance)
+			nChanged++;
+	}
+	float changed = (float) nChanged/(width*height);
+	bool ok = changed <= areaTolerance;
+	printf("%s: %3.3f%% pixels changed (%3.1f%% allowed)\n", ok? "pass" : "FAIL", 100*changed, 100*areaTolerance);
+	return ok;
+}
+
+int CheckGolden() {
+	// 0 if both draw time and frame pass, else 1; both are always checked
+	bool timeOk = CheckDrawTime(), imageOk = CheckImage();
+	return timeOk && imageOk? 0 : 1;
 }
 
 // Application
 
 void WriteObjFile(const char *filename) {
-	FILE *file = fopen(filename, "w");
+	FILE *file = MeshIdle()? fopen(filename, "w") : NULL;
 	if (!file)
 		printf("can't save %s\n", filename);
 	else {
-		int nVertices = sizeof(triangles)/sizeof(int), nTriangles = nVertices/3;
+		int nPoints = points.size(), nTriangles = triangles.size();
 		fprintf(file, "\n# %i vertices\n", nPoints);
 		for (int i = 0; i < nPoints; i++)
 			fprintf(file, "v %f %f %f \n", points[i].x, points[i].y, points[i].z);
-		fprintf(file, "\n# %i textures\n", nPoints);
-		for (int i = 0; i < nPoints; i++)
+		int nUvs = uvs.size() == points.size()? nPoints : 0;	// PLY files may have no uvs
+		fprintf(file, "\n# %i textures\n", nUvs);
+		for (int i = 0; i < nUvs; i++)
 			fprintf(file, "vt %f %f \n", uvs[i].x, uvs[i].y);
 		fprintf(file, "\n# %i triangles\n", nTriangles);
 		for (int i = 0; i < nTriangles; i++)
@@ -197,13 +1957,26 @@ void WriteObjFile(const char *filename) {
 }
 
 void Keyboard(int key, bool press, bool shift, bool control) {
+	if (press)
+		InputEvent(glfwGetTime());
+	if (press && key == 'L') {
+		lateLatch = !lateLatch;
+		printf("late latch %s\n", lateLatch? "on" : "off");
+	}
 	if (press && key == 'S')
 		WriteObjFile("C:/Users/Duong/Graphics/Apps/Doughnut_OBJ.obj");
-	if (press && key == 'F') { // Toggle between faceted and smooth shading when the 'F' key is pressed
-		useFacetedNormal = !useFacetedNormal;
-		glUseProgram(program);
-		glUniform1i(glGetUniformLocation(program, "useFacetedNormal"), useFacetedNormal);
+	if (press && key == 'B' && MeshIdle() && !WriteMeshFile(meshFilename.c_str()))
+		printf("can't save %s\n", meshFilename.c_str());
+	if (press && key == 'O')
+		useAo = !useAo;
+	if (press && key == 'U' && MeshIdle())
+		SetSubdivisionLevel(subdivisionLevel+(shift? -1 : 1));
+	if (press && key == 'M') {
+		PrintMemory();
+		WriteMemoryJson("Assignment-5-memory.json");
 	}
+	if (press && key == 'F') // Toggle between faceted and smooth shading when the 'F' key is pressed
+		useFacetedNormal = !useFacetedNormal;
 
 	// Varying the pixel shader values of amb, dif, spc
 	if (press) {
@@ -226,15 +1999,12 @@ void Keyboard(int key, bool press, bool shift, bool control) {
 			break;
 		}
 		// Update shader program with new values
-		glUseProgram(program);
-		glUniform1f(glGetUniformLocation(program, "ambientValue"), ambientValue);
-		glUniform1f(glGetUniformLocation(program, "diffuseValue"), diffuseValue);
-		glUniform1f(glGetUniformLocation(program, "specularValue"), specularValue);
-		glUniform1f(glGetUniformLocation(program, "shininessValue"), shininessValue);
+		SetShadingUniforms();
 	}
 }
 
 void Resize(int width, int height) {
+	winWidth = width, winHeight = height;	// overlay sizes markers in pixels
 	camera.Resize(width, height);
 	glViewport(0, 0, width, height);
 }
@@ -242,36 +2012,103 @@ void Resize(int width, int height) {
 int main(int ac, char **av) {
 	// enable anti-alias, init app window and GL context
 	GLFWwindow *w = InitGLFW(100, 100, winWidth, winHeight, "Textured Letter");
-	// init shader program, set GPU buffer, read texture image
-	program = LinkProgramViaCode(&vertexShader, &pixelShader);
-	Standardize(points.data(), points.size(), .8f);   // fit points to +/- .8 space
-	BufferVertices();
-	textureName = ReadTexture(textFilename);
+	// start mesh read, init shader program, read texture image
+	// options removed from arguments: -golden file.ppm, -blocking (read mesh before first frame),
+	// -compare (time StandardizePoints against library Standardize)
+	bool blocking = false;
+	int nArgs = 1;
+	for (int i = 1; i < ac; i++)
+		if (!strcmp(av[i], "-golden") && i+1 < ac)
+			goldenFilename = av[++i];
+		else if (!strcmp(av[i], "-blocking"))
+			blocking = true;
+		else if (!strcmp(av[i], "-compare"))
+			compareStandardize = true;
+		else
+			av[nArgs++] = av[i];
+	ac = nArgs;
+	if (ac > 1 && !strcmp(av[1], "torus")) {
+		torusRings = ac > 2? std::max(3, atoi(av[2])) : 64;
+		sourceFilename = "torus";
+		meshFilename = "torus.msh";
+	}
+	else if (ac > 1) {
+		sourceFilename = av[1];
+		meshFilename = sourceFilename.substr(0, sourceFilename.rfind('.'))+".msh";
+	}
+	loadStart = glfwGetTime();
+	if (blocking)
+		LoadMesh();	// as before threaded loading, for comparison
+	else
+		loader = std::thread(LoadMesh);
+	Changed(sourceFilename, sourceTime);
+	Changed(textFilename, textureTime);
+	Changed(vertexShaderFile, vertexShaderTime);
+	Changed(pixelShaderFile, pixelShaderTime);
+	LinkShaders();
+	textureName = ReadMipmappedTexture(textFilename);
+	if (ModifiedTime(normalMapFilename))	// normal map is optional
+		normalMapName = ReadMipmappedTexture(normalMapFilename);
+	TrackTextures();
 	// callbacks
 	RegisterMouseMove(MouseMove);
 	RegisterMouseButton(MouseButton);
 	RegisterMouseWheel(MouseWheel);
 	RegisterResize(Resize);
 	RegisterKeyboard(Keyboard);
-	printf("Usage: S to save as OBJ file\n");
-
-	if (!ReadAsciiObj("Doughnut_OBJ.obj", points, triangles, &normals, &uvs))
-	{
-		printf("can’t read %s\n", "Doughnut_OBJ.obj");
-		return 1;
-	}
-	if (!normals.size())
-		SetVertexNormals(points, triangles, normals);
-	// event loop
+	printf("Usage: S to save as OBJ file, B to save compressed, O to toggle ambient occlusion\n");
+	printf("       U/shift-U to raise/lower subdivision level, M to report memory\n");
+	printf("       L to toggle late latch of camera drag\n");
+	printf("       mesh, texture and %s/%s shader files reload when changed\n", vertexShaderFile, pixelShaderFile);
+	printf("       -golden file.ppm: compare frame and draw time with file (recorded if absent)\n");
+	printf("       -blocking: read mesh before first frame, to compare time to first mesh frame\n");
+	printf("       -compare: time StandardizePoints against library Standardize and check results agree\n");
+	// event loop: frames are drawn while the mesh loads
+	bool firstFrame = true, meshShown = false;
+	int status = 0;
 	while (!glfwWindowShouldClose(w)) {
 		glfwPollEvents();
+		PollFiles();
+		if (!UpdateMesh()) {
+			glfwDestroyWindow(w);
+			glfwTerminate();
+			return 1;
+		}
+		double drawStart = glfwGetTime();
 		Display(w);
+		if (!goldenFilename.empty() && meshBuffered) {
+			glFinish();	// time the draw, not its submission
+			drawTimes.push_back(glfwGetTime()-drawStart);
+			if ((int) drawTimes.size() == goldenFrames) {
+				status = CheckGolden();
+				break;
+			}
+		}
 		glfwSwapBuffers(w);
+		FrameShown(glfwGetTime());
+		ReloadShown();
+		if (firstFrame && !meshBuffered)
+			printf("first frame (lights only) in %3.2f secs\n", glfwGetTime()-loadStart);
+		firstFrame = false;
+		if (meshBuffered && !meshShown)
+			printf("first frame with mesh in %3.2f secs (%s load)\n", glfwGetTime()-loadStart, blocking? "blocking" : "background");
+		meshShown = meshBuffered;
 	}
+	if (loader.joinable())
+		loader.join();
+	PrintLatency();
+	PrintStateChanges();
+	PrintOverlay();
+	PrintMemory();
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glDeleteBuffers(1, &vBuffer);
+	glDeleteBuffers(1, &eBuffer);
+	glDeleteVertexArrays(1, &vArray);
+	glDeleteBuffers(1, &overlayBuffer);
+	glDeleteVertexArrays(1, &overlayArray);
 	glfwDestroyWindow(w);
 	glfwTerminate();
 
-	return 0;
+	return status;
 }
@@ -11,6 +11,7 @@
 #include "GLXtras.h"
 #include "VecMat.h"
 #include <cmath>
+#include <stdio.h>
 
 GLuint vBuffer = 0; // GPU buffer ID
 GLuint program = 0; // GLSL shader program ID
@@ -42,6 +43,20 @@ vec2 rightLetterPos = { 0.5f, 0.0f }; // Right letter initial position
 float leftRotationAngle = 0.0f; // Initial rotation angle for left letter
 float rightRotationAngle = 0.0f; // Initial rotation angle for right letter
 
+// per-vertex wave, recomputed on the CPU each frame and streamed to the GPU
+bool waving = false;
+vec2 deformed[nPoints];	// points displaced by the wave
+GLuint waveBuffer = 0;	// GPU buffer for deformed points, refilled each frame
+double waveSecs = 0;	// time spent deforming and streaming
+int nDeformed = 0;
+// frame time while waving: count, sum, sum of squares, max
+int nWaveFrames = 0;
+double frameSum = 0, frameSumSq = 0, frameMax = 0;
+
+// cached letter transforms, recomputed only after mouse input changes them
+mat4 leftView, rightView;
+bool viewChanged = true;
+
 const char *vertexShader = R"(
 	#version 130
 	in vec2 point;
@@ -63,6 +78,35 @@ const char *pixelShader = R"(
 	}
 )";
 
+void UpdateViews() {
+	// compound transform shared by both letters
+	mat4 view = RotateY(mouseNow.x) * RotateX(mouseNow.y) * RotateZ(zRotation);
+	// RotateX, RotateY are in VecMat.h
+	leftView = Translate(leftLetterPos.x, leftLetterPos.y, 0.0f) * RotateZ(leftRotationAngle) * standardizeMat * view;
+	rightView = Translate(rightLetterPos.x, rightLetterPos.y, 0.0f) * RotateZ(rightRotationAngle) * standardizeMat * view;
+	viewChanged = false;
+}
+
+void Deform(float t) {
+	// wave travels along x, displacing y; amplitude and wavelength in letter (pixel) units
+	for (int i = 0; i < nPoints; i++)
+		deformed[i] = points[i] + vec2(0, 12 * sin(points[i].x / 30 - 4 * t));
+}
+
+void StreamWave() {
+	// orphan the buffer before refilling it, so the driver hands back fresh storage
+	// rather than waiting on draws still reading last frame's points
+	double start = glfwGetTime();
+	Deform((float)start);
+	if (!waveBuffer)
+		glGenBuffers(1, &waveBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, waveBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(deformed), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(deformed), deformed);
+	waveSecs += glfwGetTime() - start;
+	nDeformed += nPoints;
+}
+
 void Display() {
 	// clear background
 	glClearColor(1, 1, 1, 1);
@@ -71,22 +115,21 @@ void Display() {
 	glUseProgram(program);
 	glBindBuffer(GL_ARRAY_BUFFER, vBuffer);
 	// connect GPU point and color buffers to shader inputs
-	VertexAttribPointer(program, "point", 2, 0, (void *) 0);
 	VertexAttribPointer(program, "color", 3, 0, (void *) sizeof(points));
-	// create compound transform and send to shader
-	mat4 view = RotateY(mouseNow.x) * RotateX(mouseNow.y) * RotateZ(zRotation);
-	// RotateX, RotateY are in VecMat.h
-	SetUniform(program, "view", view*standardizeMat);
+	if (waving)
+		StreamWave();	// points from waveBuffer instead
+	VertexAttribPointer(program, "point", 2, 0, (void *) 0);
+	// create compound transforms if rotation changed
+	if (viewChanged)
+		UpdateViews();
 	// render three vertices as one triangle
 	int nVertices = sizeof(triangles) / sizeof(int);
 
 	// Drawing left letter
-	mat4 leftView = Translate(leftLetterPos.x, leftLetterPos.y, 0.0f) * RotateZ(leftRotationAngle) * standardizeMat * view;
 	SetUniform(program, "view", leftView);
 	glDrawElements(GL_TRIANGLES, nVertices, GL_UNSIGNED_INT, triangles);
 
 	// Drawing right letter
-	mat4 rightView = Translate(rightLetterPos.x, rightLetterPos.y, 0.0f) * RotateZ(rightRotationAngle) * standardizeMat * view;
 	SetUniform(program, "view", rightView);
 	glDrawElements(GL_TRIANGLES, nVertices, GL_UNSIGNED_INT, triangles);
 	glFlush();
@@ -120,6 +163,7 @@ void MouseMove(float x, float y, bool leftDown, bool rightDown) {
 		// change in mouse position since last frame
 		vec2 mouseDelta = vec2(x, y) - mouseWas;
 		mouseNow += mouseDelta;
+		viewChanged = true;
 		// current mouse position as the last position for next frame
 		mouseWas = vec2(x, y);
 	}
@@ -136,6 +180,21 @@ void MouseWheel(float spin) {
 	zRotation += spin;
 	leftRotationAngle += spin;
 	rightRotationAngle += spin;
+	viewChanged = true;
+}
+
+void Keyboard(int key, bool press, bool shift, bool control) {
+	if (press && key == 'W')
+		waving = !waving;
+}
+
+void PrintWave() {
+	if (!nWaveFrames)
+		return;
+	double mean = frameSum / nWaveFrames, var = frameSumSq / nWaveFrames - mean * mean;
+	printf("wave: %3.1f vertices deformed and streamed per ms\n", waveSecs > 0 ? nDeformed / (1000 * waveSecs) : 0.);
+	printf("      frame time %3.2f ms mean, %3.2f ms std dev, %3.2f ms max over %i frames\n",
+		1000 * mean, 1000 * sqrt(var > 0 ? var : 0), 1000 * frameMax, nWaveFrames);
 }
 
 int main() {
@@ -152,15 +211,27 @@ int main() {
 	RegisterMouseMove(MouseMove);
 	RegisterMouseButton(MouseButton);
 	RegisterMouseWheel(MouseWheel);
+	RegisterKeyboard(Keyboard);
+	printf("Usage: W to toggle wave\n");
 	// event loop
+	double frameStart = glfwGetTime();
 	while (!glfwWindowShouldClose(w)) {
+		glfwPollEvents();	// before Display, so input shows in this frame
 		Display();
 		glfwSwapBuffers(w);
-		glfwPollEvents();
+		double now = glfwGetTime(), dt = now - frameStart;
+		frameStart = now;
+		if (waving) {
+			nWaveFrames++;
+			frameSum += dt, frameSumSq += dt * dt;
+			frameMax = dt > frameMax ? dt : frameMax;
+		}
 	}
+	PrintWave();
 	// unbind vertex buffer, free GPU memory
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glDeleteBuffers(1, &vBuffer);
+	glDeleteBuffers(1, &waveBuffer);
 	glfwDestroyWindow(w);
 	glfwTerminate();
 }